@@ -0,0 +1,403 @@
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#include "algorithms/decomposition/decomposition.h"
+#include "structures/vroom/raw_route.h"
+#include "structures/vroom/tw_route.h"
+#include "utils/helpers.h"
+
+namespace vroom::decomposition {
+
+struct SubProblem {
+  std::vector<Index> vehicle_ranks;
+  // Jobs from routes for above vehicles, along with unassigned jobs.
+  std::vector<Index> job_ranks;
+  std::size_t nb_assigned{0};
+};
+
+// Location used to decide how close routes are: middle job for
+// non-empty routes, vehicle start or end otherwise.
+template <class Route>
+Index route_location(const Input& input, const Route& route) {
+  if (!route.empty()) {
+    return input.jobs[route.route[route.size() / 2]].index();
+  }
+
+  const auto& vehicle = input.vehicles[route.vehicle_rank];
+  return vehicle.has_start() ? vehicle.start.value().index()
+                             : vehicle.end.value().index();
+}
+
+// Split routes into groups of nearby routes, peeling off groups
+// starting from the routes that are the furthest away from an anchor
+// route. Changing anchor across rounds moves boundaries between
+// sub-problems.
+template <class Route>
+std::vector<SubProblem> partition(const Input& input,
+                                  const std::vector<Route>& routes,
+                                  std::size_t sub_problem_size,
+                                  unsigned round) {
+  std::vector<Index> used_routes;
+  std::vector<Index> empty_routes;
+  std::vector<Index> locations;
+  for (const auto& route : routes) {
+    locations.push_back(route_location(input, route));
+    if (route.empty()) {
+      empty_routes.push_back(route.vehicle_rank);
+    } else {
+      used_routes.push_back(route.vehicle_rank);
+    }
+  }
+
+  std::vector<SubProblem> sub_problems;
+  if (used_routes.empty()) {
+    return sub_problems;
+  }
+
+  // Cost to go back and forth between locations for vehicle at rank
+  // v.
+  auto round_trip_cost = [&](Index v, Index from, Index to) {
+    const auto& vehicle = input.vehicles[v];
+    return vehicle.cost(from, to) + vehicle.cost(to, from);
+  };
+
+  const auto anchor = used_routes[round % used_routes.size()];
+  std::vector<Cost> costs(routes.size());
+  for (const auto v : used_routes) {
+    costs[v] = round_trip_cost(anchor, locations[anchor], locations[v]);
+  }
+  std::stable_sort(used_routes.begin(),
+                   used_routes.end(),
+                   [&](const Index lhs, const Index rhs) {
+                     return costs[lhs] > costs[rhs];
+                   });
+
+  std::vector<bool> grouped(routes.size(), false);
+  std::vector<Index> seeds;
+  std::vector<Index> candidates;
+  for (const auto seed : used_routes) {
+    if (grouped[seed]) {
+      continue;
+    }
+
+    // Add routes closest to seed until sub-problem is large enough.
+    candidates.clear();
+    for (const auto v : used_routes) {
+      if (!grouped[v]) {
+        candidates.push_back(v);
+        costs[v] = round_trip_cost(seed, locations[seed], locations[v]);
+      }
+    }
+    std::stable_sort(candidates.begin(),
+                     candidates.end(),
+                     [&](const Index lhs, const Index rhs) {
+                       return costs[lhs] < costs[rhs];
+                     });
+
+    seeds.push_back(seed);
+    auto& sub_problem = sub_problems.emplace_back();
+    for (const auto v : candidates) {
+      if (sub_problem.nb_assigned >= sub_problem_size) {
+        break;
+      }
+      grouped[v] = true;
+      sub_problem.vehicle_ranks.push_back(v);
+      sub_problem.job_ranks.insert(sub_problem.job_ranks.end(),
+                                   routes[v].route.begin(),
+                                   routes[v].route.end());
+      sub_problem.nb_assigned += routes[v].size();
+    }
+  }
+
+  // Empty routes are spread evenly across sub-problems as they
+  // usually start from a few shared depots.
+  for (std::size_t i = 0; i < empty_routes.size(); ++i) {
+    sub_problems[i % sub_problems.size()].vehicle_ranks.push_back(
+      empty_routes[i]);
+  }
+
+  // Unassigned jobs go to the sub-problem with the closest seed,
+  // along with matching delivery for pickups.
+  std::vector<bool> assigned(input.jobs.size(), false);
+  for (const auto& route : routes) {
+    for (const auto j : route.route) {
+      assigned[j] = true;
+    }
+  }
+
+  for (Index j = 0; j < input.jobs.size(); ++j) {
+    if (assigned[j] or input.jobs[j].type == JOB_TYPE::DELIVERY) {
+      continue;
+    }
+
+    std::size_t best_rank = 0;
+    Cost best_cost = std::numeric_limits<Cost>::max();
+    for (std::size_t s = 0; s < seeds.size(); ++s) {
+      const auto cost =
+        round_trip_cost(seeds[s], locations[seeds[s]], input.jobs[j].index());
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_rank = s;
+      }
+    }
+
+    auto& job_ranks = sub_problems[best_rank].job_ranks;
+    job_ranks.push_back(j);
+    if (input.jobs[j].type == JOB_TYPE::PICKUP) {
+      job_ranks.push_back(j + 1);
+    }
+  }
+
+  // Jobs are added to sub-problem instances in rank order, so that
+  // deliveries directly follow matching pickups.
+  for (auto& sub_problem : sub_problems) {
+    std::sort(sub_problem.job_ranks.begin(), sub_problem.job_ranks.end());
+  }
+
+  return sub_problems;
+}
+
+// Solve sub-problem using current routes as a starting point and
+// return resulting routes, in the order of sub-problem vehicles.
+template <class Route>
+std::vector<Route> solve_sub_problem(const Input& input,
+                                     const std::vector<Route>& routes,
+                                     const SubProblem& sub_problem,
+                                     unsigned exploration_level,
+                                     const Timeout& timeout,
+                                     const CancellationToken& cancellation,
+                                     const Budget& budget) {
+  auto sub_input =
+    input.sub_input(sub_problem.vehicle_ranks, sub_problem.job_ranks);
+
+  std::unordered_map<Id, Index> vehicle_id_to_rank;
+  for (std::size_t i = 0; i < sub_problem.vehicle_ranks.size(); ++i) {
+    const auto v = sub_problem.vehicle_ranks[i];
+    vehicle_id_to_rank[input.vehicles[v].id] = i;
+
+    std::vector<VehicleStep> steps;
+    for (const auto j : routes[v].route) {
+      steps.emplace_back(input.jobs[j].type,
+                         input.jobs[j].id,
+                         ForcedService());
+    }
+    sub_input.add_previous_route(input.vehicles[v].id, std::move(steps));
+  }
+
+  // Sub-problems are already solved in parallel.
+  constexpr unsigned sub_nb_threads = 1;
+  const auto sub_solution =
+    sub_input.solve(exploration_level,
+                    sub_nb_threads,
+                    timeout,
+                    std::vector<HeuristicParameters>(),
+                    ProgressCallback(),
+                    false,
+                    cancellation,
+                    budget);
+
+  std::vector<Route> sub_routes;
+  for (const auto v : sub_problem.vehicle_ranks) {
+    sub_routes.emplace_back(input, v, input.zero_amount().size());
+  }
+
+  for (const auto& route : sub_solution.routes) {
+    std::vector<Index> job_ranks;
+    Amount single_jobs_deliveries(input.zero_amount());
+    for (const auto& step : route.steps) {
+      if (step.step_type != STEP_TYPE::JOB) {
+        continue;
+      }
+
+      const auto& id_to_rank = (step.job_type == JOB_TYPE::SINGLE)
+                                 ? input.job_id_to_rank
+                               : (step.job_type == JOB_TYPE::PICKUP)
+                                 ? input.pickup_id_to_rank
+                                 : input.delivery_id_to_rank;
+      const auto job_rank = id_to_rank.at(step.id);
+      job_ranks.push_back(job_rank);
+
+      if (step.job_type == JOB_TYPE::SINGLE) {
+        single_jobs_deliveries += input.jobs[job_rank].delivery;
+      }
+    }
+
+    if (!job_ranks.empty()) {
+      auto& sub_route = sub_routes[vehicle_id_to_rank.at(route.vehicle)];
+      sub_route.replace(input,
+                        single_jobs_deliveries,
+                        job_ranks.begin(),
+                        job_ranks.end(),
+                        0,
+                        0);
+    }
+  }
+
+  return sub_routes;
+}
+
+template <class Route>
+void add_route_indicators(const Input& input,
+                          const Route& route,
+                          utils::SolutionIndicators<Route>& indicators) {
+  indicators.priority_sum += utils::priority_sum_for_route(input, route.route);
+  indicators.assigned += route.size();
+  indicators.eval +=
+    utils::route_eval_for_vehicle(input, route.vehicle_rank, route.route);
+  if (!route.empty()) {
+    ++indicators.used_vehicles;
+  }
+}
+
+template <class Route>
+void improve(const Input& input,
+             std::vector<Route>& routes,
+             std::size_t sub_problem_size,
+             unsigned exploration_level,
+             unsigned nb_threads,
+             const Timeout& timeout,
+             const CancellationToken& cancellation,
+             const Budget& budget,
+             const ImprovementCallback<Route>& callback) {
+  Deadline deadline;
+  if (timeout.has_value()) {
+    deadline = utils::now() + timeout.value();
+  }
+
+  const unsigned max_rounds_without_improvement = exploration_level + 1;
+  unsigned rounds_without_improvement = 0;
+
+  for (unsigned round = 0;
+       rounds_without_improvement < max_rounds_without_improvement and
+       !cancellation.is_cancelled();
+       ++round) {
+    const auto sub_problems =
+      partition(input, routes, sub_problem_size, round);
+    if (sub_problems.empty()) {
+      break;
+    }
+
+    // Decide time and steps allocated for each sub-problem.
+    const std::size_t nb_waves =
+      (sub_problems.size() + nb_threads - 1) / nb_threads;
+    Timeout sub_timeout;
+    if (deadline.has_value()) {
+      const auto now = utils::now();
+      if (deadline.value() <= now) {
+        break;
+      }
+      sub_timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      deadline.value() - now) /
+                    nb_waves;
+    }
+    Budget sub_budget;
+    if (budget.has_value()) {
+      sub_budget = budget.value() / sub_problems.size();
+    }
+
+    std::vector<std::vector<Route>> sub_routes(sub_problems.size());
+
+    std::vector<std::vector<std::size_t>>
+      thread_ranks(std::min<std::size_t>(nb_threads, sub_problems.size()));
+    for (std::size_t i = 0; i < sub_problems.size(); ++i) {
+      thread_ranks[i % thread_ranks.size()].push_back(i);
+    }
+
+    std::exception_ptr ep = nullptr;
+    std::mutex ep_m;
+
+    auto run_solve = [&](const std::vector<std::size_t>& sub_ranks) {
+      try {
+        for (const auto rank : sub_ranks) {
+          sub_routes[rank] = solve_sub_problem(input,
+                                               routes,
+                                               sub_problems[rank],
+                                               exploration_level,
+                                               sub_timeout,
+                                               cancellation,
+                                               sub_budget);
+        }
+      } catch (...) {
+        ep_m.lock();
+        ep = std::current_exception();
+        ep_m.unlock();
+      }
+    };
+
+    std::vector<std::thread> solve_threads;
+    for (const auto& sub_ranks : thread_ranks) {
+      solve_threads.emplace_back(run_solve, sub_ranks);
+    }
+
+    for (auto& t : solve_threads) {
+      t.join();
+    }
+
+    if (ep != nullptr) {
+      std::rethrow_exception(ep);
+    }
+
+    // Sub-problems do not share any vehicle or job, so improved
+    // routes from each of them can be kept independently.
+    bool improved = false;
+    for (std::size_t i = 0; i < sub_problems.size(); ++i) {
+      utils::SolutionIndicators<Route> current_indicators;
+      utils::SolutionIndicators<Route> sub_indicators;
+      for (const auto v : sub_problems[i].vehicle_ranks) {
+        add_route_indicators(input, routes[v], current_indicators);
+      }
+      for (const auto& route : sub_routes[i]) {
+        add_route_indicators(input, route, sub_indicators);
+      }
+
+      if (sub_indicators < current_indicators) {
+        improved = true;
+        for (auto& route : sub_routes[i]) {
+          const auto v = route.vehicle_rank;
+          routes[v] = std::move(route);
+        }
+      }
+    }
+
+    if (improved) {
+      rounds_without_improvement = 0;
+      if (callback) {
+        callback(routes, utils::SolutionIndicators<Route>(input, routes));
+      }
+    } else {
+      ++rounds_without_improvement;
+    }
+  }
+}
+
+template void improve(const Input& input,
+                      std::vector<RawRoute>& routes,
+                      std::size_t sub_problem_size,
+                      unsigned exploration_level,
+                      unsigned nb_threads,
+                      const Timeout& timeout,
+                      const CancellationToken& cancellation,
+                      const Budget& budget,
+                      const ImprovementCallback<RawRoute>& callback);
+
+template void improve(const Input& input,
+                      std::vector<TWRoute>& routes,
+                      std::size_t sub_problem_size,
+                      unsigned exploration_level,
+                      unsigned nb_threads,
+                      const Timeout& timeout,
+                      const CancellationToken& cancellation,
+                      const Budget& budget,
+                      const ImprovementCallback<TWRoute>& callback);
+
+} // namespace vroom::decomposition
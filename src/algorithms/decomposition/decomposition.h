@@ -0,0 +1,47 @@
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <functional>
+
+#include "structures/vroom/cancellation_token.h"
+#include "structures/vroom/input/input.h"
+#include "structures/vroom/solution_indicators.h"
+
+namespace vroom::decomposition {
+
+// Called each time routes are improved.
+template <class Route>
+using ImprovementCallback =
+  std::function<void(const std::vector<Route>&,
+                     const utils::SolutionIndicators<Route>&)>;
+
+// Improve routes by repeatedly partitioning them into groups of
+// nearby routes holding around sub_problem_size jobs, solving the
+// matching sub-problems in parallel then keeping improved routes.
+// Unassigned jobs are added to the closest sub-problem. Stops upon
+// timeout or after exploration_level + 1 rounds in a row without
+// improvement. When set, budget applies to each round.
+template <class Route>
+void improve(const Input& input,
+             std::vector<Route>& routes,
+             std::size_t sub_problem_size,
+             unsigned exploration_level,
+             unsigned nb_threads,
+             const Timeout& timeout,
+             const CancellationToken& cancellation,
+             const Budget& budget,
+             const ImprovementCallback<Route>& callback =
+               ImprovementCallback<Route>());
+
+} // namespace vroom::decomposition
+
+#endif
@@ -0,0 +1,500 @@
+#ifndef GENETIC_H
+#define GENETIC_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <thread>
+
+#include "structures/vroom/cancellation_token.h"
+#include "structures/vroom/input/input.h"
+#include "structures/vroom/solution/solving_stats.h"
+#include "structures/vroom/solution_indicators.h"
+#include "utils/helpers.h"
+
+namespace vroom::genetic {
+
+template <class Route> struct Individual {
+  std::vector<Route> routes;
+  utils::SolutionIndicators<Route> indicators;
+  // successors[j] is the job following job j in its route, or
+  // input.jobs.size() for the last job in a route and
+  // input.jobs.size() + 1 for unassigned jobs.
+  std::vector<Index> successors;
+  double biased_fitness{0};
+
+  Individual(const Input& input, std::vector<Route>&& sol)
+    : routes(std::move(sol)),
+      indicators(input, routes),
+      successors(input.jobs.size(), input.jobs.size() + 1) {
+    for (const auto& r : routes) {
+      for (std::size_t i = 0; i < r.size(); ++i) {
+        successors[r.route[i]] =
+          (i + 1 < r.size()) ? r.route[i + 1] : input.jobs.size();
+      }
+    }
+  }
+};
+
+// Share of jobs with a different successor in both individuals.
+template <class Route>
+double distance(const Individual<Route>& lhs, const Individual<Route>& rhs) {
+  assert(lhs.successors.size() == rhs.successors.size());
+  if (lhs.successors.empty()) {
+    return 0;
+  }
+
+  std::size_t nb_broken = 0;
+  for (std::size_t j = 0; j < lhs.successors.size(); ++j) {
+    if (lhs.successors[j] != rhs.successors[j]) {
+      ++nb_broken;
+    }
+  }
+  return static_cast<double>(nb_broken) /
+         static_cast<double>(lhs.successors.size());
+}
+
+// Selective route exchange: copy a random group of nearby routes from
+// first, then fill other vehicles with their routes from second
+// without the jobs already copied. Jobs missing from the result are
+// left unassigned, to be inserted during education.
+template <class Route>
+std::vector<Route> crossover(const Input& input,
+                             const std::vector<Route>& first,
+                             const std::vector<Route>& second,
+                             std::mt19937& rng) {
+  std::vector<Index> used_routes;
+  for (const auto& r : first) {
+    if (!r.empty()) {
+      used_routes.push_back(r.vehicle_rank);
+    }
+  }
+  if (used_routes.empty()) {
+    return second;
+  }
+
+  auto location = [&](const Route& r) {
+    return input.jobs[r.route[r.size() / 2]].index();
+  };
+
+  const auto anchor = used_routes[std::uniform_int_distribution<std::size_t>(
+    0,
+    used_routes.size() - 1)(rng)];
+  const auto& anchor_vehicle = input.vehicles[anchor];
+  const auto anchor_location = location(first[anchor]);
+
+  std::vector<Cost> costs(first.size());
+  for (const auto v : used_routes) {
+    const auto v_location = location(first[v]);
+    costs[v] = anchor_vehicle.cost(anchor_location, v_location) +
+               anchor_vehicle.cost(v_location, anchor_location);
+  }
+  std::stable_sort(used_routes.begin(),
+                   used_routes.end(),
+                   [&](const auto lhs, const auto rhs) {
+                     return costs[lhs] < costs[rhs];
+                   });
+
+  const auto nb_copied = std::uniform_int_distribution<std::size_t>(
+    1,
+    std::max<std::size_t>(used_routes.size() / 2, 1))(rng);
+
+  std::vector<bool> copied_route(first.size(), false);
+  std::vector<bool> copied_job(input.jobs.size(), false);
+  for (std::size_t i = 0; i < nb_copied; ++i) {
+    const auto v = used_routes[i];
+    copied_route[v] = true;
+    for (const auto j : first[v].route) {
+      copied_job[j] = true;
+    }
+  }
+
+  std::vector<Route> child;
+  child.reserve(first.size());
+  for (Index v = 0; v < first.size(); ++v) {
+    if (copied_route[v]) {
+      child.push_back(first[v]);
+      continue;
+    }
+
+    std::vector<Index> kept;
+    Amount delivery = input.zero_amount();
+    for (const auto j : second[v].route) {
+      if (!copied_job[j]) {
+        kept.push_back(j);
+        if (input.jobs[j].type == JOB_TYPE::SINGLE) {
+          delivery += input.jobs[j].delivery;
+        }
+      }
+    }
+
+    if (kept.size() == second[v].size()) {
+      child.push_back(second[v]);
+      continue;
+    }
+
+    child.emplace_back(input, v, input.zero_amount().size());
+    if (kept.empty()) {
+      continue;
+    }
+
+    // Removing jobs can lead to an invalid route (see #172), or
+    // increase travel time without triangular inequality, in which
+    // case all jobs are left for education.
+    const auto kept_eval = utils::route_eval_for_vehicle(input, v, kept);
+    if (input.vehicles[v].ok_for_travel_time(kept_eval.duration) and
+        child.back().is_valid_addition_for_tw(input,
+                                              delivery,
+                                              kept.begin(),
+                                              kept.end(),
+                                              0,
+                                              0)) {
+      child.back().replace(input, delivery, kept.begin(), kept.end(), 0, 0);
+    }
+  }
+
+  return child;
+}
+
+// Population of solutions evolved on its own, up to migrations.
+template <class Route, class LocalSearch> class Population {
+private:
+  const Input& _input;
+  const unsigned _max_nb_jobs_removal;
+  const typename LocalSearch::BestSolutionCallback _callback;
+  std::mt19937 _rng;
+
+  std::vector<Individual<Route>> _population;
+  std::optional<Individual<Route>> _best;
+
+  // Distances between individuals, kept up to date when adding or
+  // removing an individual.
+  std::vector<std::vector<double>> _distances;
+
+  // Steps spent in education.
+  uint64_t _nb_steps{0};
+
+  void remove(std::size_t rank) {
+    _population.erase(_population.begin() + rank);
+    _distances.erase(_distances.begin() + rank);
+    for (auto& row : _distances) {
+      row.erase(row.begin() + rank);
+    }
+  }
+
+  // Biased fitness combines ranks for solution quality and for
+  // average distance to closest individuals, the latter having less
+  // weight for small populations so that best individuals survive.
+  void update_biased_fitness() {
+    const auto& d = _distances;
+    const auto n = _population.size();
+    if (n == 1) {
+      _population.front().biased_fitness = 0;
+      return;
+    }
+
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [&](const auto lhs, const auto rhs) {
+                       return _population[lhs].indicators <
+                              _population[rhs].indicators;
+                     });
+    std::vector<double> cost_rank(n);
+    for (std::size_t r = 0; r < n; ++r) {
+      cost_rank[order[r]] = static_cast<double>(r) / (n - 1);
+    }
+
+    const auto nb_close = std::min(GENETIC_NB_CLOSE, n - 1);
+    std::vector<double> diversity(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      auto others = d[i];
+      others.erase(others.begin() + i);
+      std::partial_sort(others.begin(),
+                        others.begin() + nb_close,
+                        others.end());
+      diversity[i] =
+        std::accumulate(others.begin(), others.begin() + nb_close, 0.0) /
+        nb_close;
+    }
+
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [&](const auto lhs, const auto rhs) {
+                       return diversity[lhs] > diversity[rhs];
+                     });
+
+    const double diversity_weight =
+      1 - static_cast<double>(std::min(GENETIC_NB_ELITE, n)) / n;
+    for (std::size_t r = 0; r < n; ++r) {
+      const auto i = order[r];
+      _population[i].biased_fitness =
+        cost_rank[i] + diversity_weight * static_cast<double>(r) / (n - 1);
+    }
+  }
+
+  // Remove individuals with the worst biased fitness, clones first,
+  // until population is back to GENETIC_POPULATION_SIZE.
+  void select_survivors() {
+    while (_population.size() > GENETIC_POPULATION_SIZE) {
+      update_biased_fitness();
+      const auto& d = _distances;
+
+      std::size_t worst = 0;
+      bool worst_is_clone = false;
+      for (std::size_t i = 0; i < _population.size(); ++i) {
+        const bool is_clone =
+          std::any_of(_population.begin(),
+                      _population.end(),
+                      [&](const auto& other) {
+                        const auto j = &other - _population.data();
+                        return static_cast<std::size_t>(j) != i and
+                               d[i][j] == 0;
+                      });
+        if ((is_clone and !worst_is_clone) or
+            (is_clone == worst_is_clone and
+             _population[worst].biased_fitness <
+               _population[i].biased_fitness)) {
+          worst = i;
+          worst_is_clone = is_clone;
+        }
+      }
+
+      remove(worst);
+    }
+  }
+
+  // Binary tournament on biased fitness.
+  const Individual<Route>& select_parent() {
+    std::uniform_int_distribution<std::size_t> pick(0,
+                                                    _population.size() - 1);
+    const auto& first = _population[pick(_rng)];
+    const auto& second = _population[pick(_rng)];
+    return (second.biased_fitness < first.biased_fitness) ? second : first;
+  }
+
+public:
+  Population(const Input& input,
+             unsigned max_nb_jobs_removal,
+             const typename LocalSearch::BestSolutionCallback& callback,
+             unsigned seed)
+    : _input(input),
+      _max_nb_jobs_removal(max_nb_jobs_removal),
+      _callback(callback),
+      _rng(seed) {
+  }
+
+  void add(std::vector<Route>&& sol) {
+    _population.emplace_back(_input, std::move(sol));
+
+    const auto& added = _population.back();
+    std::vector<double> added_distances(_population.size(), 0);
+    for (std::size_t i = 0; i + 1 < _population.size(); ++i) {
+      added_distances[i] = distance(_population[i], added);
+      _distances[i].push_back(added_distances[i]);
+    }
+    _distances.push_back(std::move(added_distances));
+
+    if (!_best.has_value() or
+        _population.back().indicators < _best.value().indicators) {
+      _best = _population.back();
+    }
+
+    if (_population.size() >
+        GENETIC_POPULATION_SIZE + GENETIC_GENERATION_SIZE) {
+      select_survivors();
+    }
+  }
+
+  const Individual<Route>& best() const {
+    assert(_best.has_value());
+    return _best.value();
+  }
+
+  bool stop(const Deadline& deadline,
+            const Budget& budget,
+            const CancellationToken& cancellation) const {
+    return cancellation.is_cancelled() or
+           (deadline.has_value() and deadline.value() < utils::now()) or
+           (budget.has_value() and budget.value() <= _nb_steps);
+  }
+
+  // Add up to nb_offspring children, each one resulting from the
+  // crossover of two parents followed by local search.
+  void evolve(unsigned nb_offspring,
+              const Deadline& deadline,
+              const Budget& budget,
+              const CancellationToken& cancellation,
+              SolvingStats& stats) {
+    for (unsigned i = 0;
+         i < nb_offspring and !_population.empty() and
+         !stop(deadline, budget, cancellation);
+         ++i) {
+      update_biased_fitness();
+      const auto& first = select_parent();
+      const auto& second = select_parent();
+      auto child = crossover(_input, first.routes, second.routes, _rng);
+
+      Timeout timeout;
+      if (deadline.has_value()) {
+        timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline.value() - utils::now());
+      }
+      Budget ls_budget;
+      if (budget.has_value()) {
+        ls_budget = budget.value() - _nb_steps;
+      }
+
+      LocalSearch ls(_input,
+                     child,
+                     _max_nb_jobs_removal,
+                     timeout,
+                     ls_budget,
+                     cancellation,
+                     _callback);
+      ls.insert_unassigned();
+      ls.descend();
+
+      _nb_steps += ls.get_nb_steps();
+      const auto ls_stats = ls.get_stats();
+      for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+        stats.operators[op] += ls_stats[op];
+      }
+      stats.state_updates += ls.get_state_updates_time();
+      stats.job_additions += ls.get_job_additions_time();
+
+      add(std::move(child));
+    }
+  }
+};
+
+// Number of populations evolved in parallel, each one starting with
+// at least two solutions when possible.
+inline std::size_t nb_islands(unsigned nb_threads, std::size_t nb_solutions) {
+  return std::max<std::size_t>(std::min<std::size_t>(nb_threads,
+                                                     nb_solutions / 2),
+                               1);
+}
+
+// Evolve one population per thread starting from given solutions,
+// with the best individual of each population copied to the next
+// one every GENETIC_MIGRATION_PERIOD offspring. Populations evolve
+// in parallel between migrations so results only depend on budget,
+// not on threads scheduling. When set, budget applies to each
+// population. Return best solution found.
+template <class Route, class LocalSearch>
+std::vector<Route>
+evolve(const Input& input,
+       std::vector<std::vector<Route>>&& solutions,
+       unsigned max_nb_jobs_removal,
+       unsigned nb_threads,
+       const Timeout& timeout,
+       const CancellationToken& cancellation,
+       const Budget& budget,
+       const typename LocalSearch::BestSolutionCallback& callback,
+       SolvingStats& stats) {
+  assert(!solutions.empty());
+
+  Deadline deadline;
+  if (timeout.has_value()) {
+    deadline = utils::now() + timeout.value();
+  }
+
+  const auto nb_populations = nb_islands(nb_threads, solutions.size());
+
+  std::vector<Population<Route, LocalSearch>> populations;
+  for (std::size_t i = 0; i < nb_populations; ++i) {
+    populations.emplace_back(input, max_nb_jobs_removal, callback, i);
+  }
+  for (std::size_t i = 0; i < solutions.size(); ++i) {
+    populations[i % nb_populations].add(std::move(solutions[i]));
+  }
+
+  std::vector<SolvingStats> populations_stats(nb_populations);
+
+  std::exception_ptr ep = nullptr;
+  std::mutex ep_m;
+
+  auto run_evolve = [&](std::size_t rank) {
+    try {
+      populations[rank].evolve(GENETIC_MIGRATION_PERIOD,
+                               deadline,
+                               budget,
+                               cancellation,
+                               populations_stats[rank]);
+    } catch (...) {
+      ep_m.lock();
+      ep = std::current_exception();
+      ep_m.unlock();
+    }
+  };
+
+  auto all_stopped = [&]() {
+    return std::all_of(populations.begin(),
+                       populations.end(),
+                       [&](const auto& p) {
+                         return p.stop(deadline,
+                                       budget,
+                                       cancellation);
+                       });
+  };
+
+  while (!all_stopped()) {
+    std::vector<std::thread> evolve_threads;
+    for (std::size_t i = 0; i < nb_populations; ++i) {
+      evolve_threads.emplace_back(run_evolve, i);
+    }
+
+    for (auto& t : evolve_threads) {
+      t.join();
+    }
+
+    if (ep != nullptr) {
+      std::rethrow_exception(ep);
+    }
+
+    if (nb_populations > 1) {
+      std::vector<std::vector<Route>> migrants;
+      for (const auto& p : populations) {
+        migrants.push_back(p.best().routes);
+      }
+      for (std::size_t i = 0; i < nb_populations; ++i) {
+        populations[(i + 1) % nb_populations].add(std::move(migrants[i]));
+      }
+    }
+  }
+
+  for (const auto& p_stats : populations_stats) {
+    for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+      stats.operators[op] += p_stats.operators[op];
+    }
+    stats.state_updates += p_stats.state_updates;
+    stats.job_additions += p_stats.job_additions;
+  }
+
+  const auto best =
+    std::min_element(populations.begin(),
+                     populations.end(),
+                     [](const auto& lhs, const auto& rhs) {
+                       return lhs.best().indicators < rhs.best().indicators;
+                     });
+  return best->best().routes;
+}
+
+} // namespace vroom::genetic
+
+#endif
@@ -0,0 +1,140 @@
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <algorithm>
+#include <numeric>
+
+#include "algorithms/heuristics/heuristic_context.h"
+
+namespace vroom::heuristics {
+
+std::vector<std::vector<Eval>> get_jobs_vehicles_evals(const Input& input) {
+  std::vector<std::vector<Eval>> evals(input.jobs.size(),
+                                       std::vector<Eval>(
+                                         input.vehicles.size()));
+  for (std::size_t j = 0; j < input.jobs.size(); ++j) {
+    Index j_index = input.jobs[j].index();
+    bool is_pickup = (input.jobs[j].type == JOB_TYPE::PICKUP);
+
+    Index last_job_index = j_index;
+    if (is_pickup) {
+      assert((j + 1 < input.jobs.size()) and
+             (input.jobs[j + 1].type == JOB_TYPE::DELIVERY));
+      last_job_index = input.jobs[j + 1].index();
+    }
+
+    for (std::size_t v = 0; v < input.vehicles.size(); ++v) {
+      const auto& vehicle = input.vehicles[v];
+      Eval current_eval =
+        is_pickup ? vehicle.eval(j_index, last_job_index) : Eval();
+      if (vehicle.has_start()) {
+        current_eval += vehicle.eval(vehicle.start.value().index(), j_index);
+      }
+      if (vehicle.has_end()) {
+        current_eval +=
+          vehicle.eval(last_job_index, vehicle.end.value().index());
+      }
+      evals[j][v] = current_eval;
+      if (is_pickup) {
+        // Assign same eval to delivery.
+        evals[j + 1][v] = current_eval;
+      }
+    }
+
+    if (is_pickup) {
+      // Skip delivery.
+      ++j;
+    }
+  }
+
+  return evals;
+}
+
+std::vector<Index> get_sorted_vehicles(const Input& input, SORT sort) {
+  std::vector<Index> vehicles_ranks(input.vehicles.size());
+  std::iota(vehicles_ranks.begin(), vehicles_ranks.end(), 0);
+
+  switch (sort) {
+  case SORT::CAPACITY:
+    // Sort vehicles by decreasing max number of tasks allowed, then
+    // capacity (not a total order), then working hours length.
+    std::stable_sort(vehicles_ranks.begin(),
+                     vehicles_ranks.end(),
+                     [&](const auto lhs, const auto rhs) {
+                       auto& v_lhs = input.vehicles[lhs];
+                       auto& v_rhs = input.vehicles[rhs];
+                       return v_lhs.max_tasks > v_rhs.max_tasks or
+                              (v_lhs.max_tasks == v_rhs.max_tasks and
+                               (v_rhs.capacity << v_lhs.capacity or
+                                (v_lhs.capacity == v_rhs.capacity and
+                                 v_lhs.tw.length > v_rhs.tw.length)));
+                     });
+    break;
+  case SORT::COST:
+    // Sort vehicles by increasing fixed cost, then same as above.
+    std::stable_sort(vehicles_ranks.begin(),
+                     vehicles_ranks.end(),
+                     [&](const auto lhs, const auto rhs) {
+                       auto& v_lhs = input.vehicles[lhs];
+                       auto& v_rhs = input.vehicles[rhs];
+                       return v_lhs.costs < v_rhs.costs or
+                              (v_lhs.costs == v_rhs.costs and
+                               (v_lhs.max_tasks > v_rhs.max_tasks or
+                                (v_lhs.max_tasks == v_rhs.max_tasks and
+                                 (v_rhs.capacity << v_lhs.capacity or
+                                  (v_lhs.capacity == v_rhs.capacity and
+                                   v_lhs.tw.length > v_rhs.tw.length)))));
+                     });
+    break;
+  }
+
+  return vehicles_ranks;
+}
+
+std::vector<std::vector<Cost>>
+get_regrets(const Input& input,
+            const std::vector<std::vector<Eval>>& evals,
+            const std::vector<Index>& vehicles_ranks) {
+  const auto nb_vehicles = input.vehicles.size();
+  std::vector<std::vector<Cost>> regrets(nb_vehicles,
+                                         std::vector<Cost>(input.jobs.size()));
+
+  // Use own cost for last vehicle regret values.
+  auto& last_regrets = regrets.back();
+  for (Index j = 0; j < input.jobs.size(); ++j) {
+    last_regrets[j] = evals[j][vehicles_ranks.back()].cost;
+  }
+
+  for (Index rev_v = 0; rev_v < nb_vehicles - 1; ++rev_v) {
+    // Going trough vehicles backward from second to last.
+    const auto v = nb_vehicles - 2 - rev_v;
+    for (Index j = 0; j < input.jobs.size(); ++j) {
+      regrets[v][j] =
+        std::min(regrets[v + 1][j], (evals[j][vehicles_ranks[v + 1]]).cost);
+    }
+  }
+
+  return regrets;
+}
+
+HeuristicContext::HeuristicContext(const Input& input,
+                                   const std::set<SORT>& regret_sorts)
+  : _evals(get_jobs_vehicles_evals(input)),
+    _capacity_sorted_vehicles(get_sorted_vehicles(input, SORT::CAPACITY)),
+    _cost_sorted_vehicles(get_sorted_vehicles(input, SORT::COST)) {
+  if (regret_sorts.find(SORT::CAPACITY) != regret_sorts.end()) {
+    _capacity_sorted_regrets =
+      get_regrets(input, _evals, _capacity_sorted_vehicles);
+  }
+  if (regret_sorts.find(SORT::COST) != regret_sorts.end()) {
+    _cost_sorted_regrets = get_regrets(input, _evals, _cost_sorted_vehicles);
+  }
+}
+
+} // namespace vroom::heuristics
@@ -0,0 +1,61 @@
+#ifndef HEURISTIC_CONTEXT_H
+#define HEURISTIC_CONTEXT_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <set>
+
+#include "structures/vroom/input/input.h"
+
+namespace vroom::heuristics {
+
+// Data only depending on input that is shared across all heuristic
+// runs. Built once prior to solving, then only read from several
+// threads.
+class HeuristicContext {
+private:
+  std::vector<std::vector<Eval>> _evals;
+  std::vector<Index> _capacity_sorted_vehicles;
+  std::vector<Index> _cost_sorted_vehicles;
+  std::vector<std::vector<Cost>> _capacity_sorted_regrets;
+  std::vector<std::vector<Cost>> _cost_sorted_regrets;
+
+public:
+  // Regrets are only computed for sort values in regret_sorts.
+  HeuristicContext(const Input& input, const std::set<SORT>& regret_sorts);
+
+  // For a single job j, evals()[j][v] evaluates fetching job j in an
+  // empty route from vehicle at rank v. For a pickup job j,
+  // evals()[j][v] evaluates fetching job j **and** associated
+  // delivery in an empty route from vehicle at rank v.
+  const std::vector<std::vector<Eval>>& evals() const {
+    return _evals;
+  }
+
+  // Vehicle ranks in the order they should be used for given sort.
+  const std::vector<Index>& vehicles_ranks(SORT sort) const {
+    return (sort == SORT::CAPACITY) ? _capacity_sorted_vehicles
+                                    : _cost_sorted_vehicles;
+  }
+
+  // regrets(sort)[v][j] holds the min cost for reaching job j in an
+  // empty route across all remaining vehicles **after** vehicle at
+  // rank v in vehicles_ranks(sort).
+  const std::vector<std::vector<Cost>>& regrets(SORT sort) const {
+    const auto& regrets = (sort == SORT::CAPACITY) ? _capacity_sorted_regrets
+                                                   : _cost_sorted_regrets;
+    assert(!regrets.empty());
+    return regrets;
+  }
+};
+
+} // namespace vroom::heuristics
+
+#endif
@@ -7,61 +7,24 @@ All rights reserved (see LICENSE).
 
 */
 
+#include <mutex>
 #include <set>
+#include <thread>
 
 #include "algorithms/heuristics/heuristics.h"
+#include "algorithms/heuristics/insertion_cache.h"
+#include "algorithms/local_search/insertion_search.h"
 #include "utils/helpers.h"
 
 namespace vroom::heuristics {
 
-std::vector<std::vector<Eval>> get_jobs_vehicles_evals(const Input& input) {
-  // For a single job j, evals[j][v] evaluates fetching job j in an
-  // empty route from vehicle at rank v. For a pickup job j,
-  // evals[j][v] evaluates fetching job j **and** associated delivery
-  // in an empty route from vehicle at rank v.
-  std::vector<std::vector<Eval>> evals(input.jobs.size(),
-                                       std::vector<Eval>(
-                                         input.vehicles.size()));
-  for (std::size_t j = 0; j < input.jobs.size(); ++j) {
-    Index j_index = input.jobs[j].index();
-    bool is_pickup = (input.jobs[j].type == JOB_TYPE::PICKUP);
-
-    Index last_job_index = j_index;
-    if (is_pickup) {
-      assert((j + 1 < input.jobs.size()) and
-             (input.jobs[j + 1].type == JOB_TYPE::DELIVERY));
-      last_job_index = input.jobs[j + 1].index();
-    }
-
-    for (std::size_t v = 0; v < input.vehicles.size(); ++v) {
-      const auto& vehicle = input.vehicles[v];
-      Eval current_eval =
-        is_pickup ? vehicle.eval(j_index, last_job_index) : Eval();
-      if (vehicle.has_start()) {
-        current_eval += vehicle.eval(vehicle.start.value().index(), j_index);
-      }
-      if (vehicle.has_end()) {
-        current_eval +=
-          vehicle.eval(last_job_index, vehicle.end.value().index());
-      }
-      evals[j][v] = current_eval;
-      if (is_pickup) {
-        // Assign same eval to delivery.
-        evals[j + 1][v] = current_eval;
-      }
-    }
-
-    if (is_pickup) {
-      // Skip delivery.
-      ++j;
-    }
-  }
-
-  return evals;
-}
-
 template <class T>
-T basic(const Input& input, INIT init, double lambda, SORT sort) {
+T basic(const Input& input,
+        const HeuristicContext& context,
+        INIT init,
+        double lambda,
+        SORT sort,
+        const CancellationToken& cancellation) {
   const auto nb_vehicles = input.vehicles.size();
   T routes;
   for (Index v = 0; v < nb_vehicles; ++v) {
@@ -75,67 +38,19 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
 
   // One level of indirection to allow easy ordering of the vehicles
   // within the heuristic.
-  std::vector<Index> vehicles_ranks(nb_vehicles);
-  std::iota(vehicles_ranks.begin(), vehicles_ranks.end(), 0);
-
-  switch (sort) {
-  case SORT::CAPACITY:
-    // Sort vehicles by decreasing max number of tasks allowed, then
-    // capacity (not a total order), then working hours length.
-    std::stable_sort(vehicles_ranks.begin(),
-                     vehicles_ranks.end(),
-                     [&](const auto lhs, const auto rhs) {
-                       auto& v_lhs = input.vehicles[lhs];
-                       auto& v_rhs = input.vehicles[rhs];
-                       return v_lhs.max_tasks > v_rhs.max_tasks or
-                              (v_lhs.max_tasks == v_rhs.max_tasks and
-                               (v_rhs.capacity << v_lhs.capacity or
-                                (v_lhs.capacity == v_rhs.capacity and
-                                 v_lhs.tw.length > v_rhs.tw.length)));
-                     });
-    break;
-  case SORT::COST:
-    // Sort vehicles by increasing fixed cost, then same as above.
-    std::stable_sort(vehicles_ranks.begin(),
-                     vehicles_ranks.end(),
-                     [&](const auto lhs, const auto rhs) {
-                       auto& v_lhs = input.vehicles[lhs];
-                       auto& v_rhs = input.vehicles[rhs];
-                       return v_lhs.costs < v_rhs.costs or
-                              (v_lhs.costs == v_rhs.costs and
-                               (v_lhs.max_tasks > v_rhs.max_tasks or
-                                (v_lhs.max_tasks == v_rhs.max_tasks and
-                                 (v_rhs.capacity << v_lhs.capacity or
-                                  (v_lhs.capacity == v_rhs.capacity and
-                                   v_lhs.tw.length > v_rhs.tw.length)))));
-                     });
-    break;
-  }
-
-  auto evals = get_jobs_vehicles_evals(input);
+  const auto& vehicles_ranks = context.vehicles_ranks(sort);
+  const auto& evals = context.evals();
 
   // regrets[v][j] holds the min cost for reaching job j in an empty
   // route across all remaining vehicles **after** vehicle at rank v
   // in vehicle_ranks.
-  std::vector<std::vector<Cost>> regrets(nb_vehicles,
-                                         std::vector<Cost>(input.jobs.size()));
-
-  // Use own cost for last vehicle regret values.
-  auto& last_regrets = regrets.back();
-  for (Index j = 0; j < input.jobs.size(); ++j) {
-    last_regrets[j] = evals[j][vehicles_ranks.back()].cost;
-  }
+  const auto& regrets = context.regrets(sort);
 
-  for (Index rev_v = 0; rev_v < nb_vehicles - 1; ++rev_v) {
-    // Going trough vehicles backward from second to last.
-    const auto v = nb_vehicles - 2 - rev_v;
-    for (Index j = 0; j < input.jobs.size(); ++j) {
-      regrets[v][j] =
-        std::min(regrets[v + 1][j], (evals[j][vehicles_ranks[v + 1]]).cost);
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    if (cancellation.is_cancelled()) {
+      break;
     }
-  }
 
-  for (Index v = 0; v < nb_vehicles; ++v) {
     auto v_rank = vehicles_ranks[v];
     auto& current_r = routes[v_rank];
 
@@ -257,8 +172,12 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
       }
     }
 
+    InsertionCache<typename T::value_type> insertion_cache(input,
+                                                           v_rank,
+                                                           current_r);
+
     bool keep_going = true;
-    while (keep_going) {
+    while (keep_going and !cancellation.is_cancelled()) {
       keep_going = false;
       double best_cost = std::numeric_limits<double>::max();
       Index best_job_rank = 0;
@@ -279,31 +198,18 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
 
         if (input.jobs[job_rank].type == JOB_TYPE::SINGLE and
             current_r.size() + 1 <= vehicle.max_tasks) {
-          for (Index r = 0; r <= current_r.size(); ++r) {
-            const auto current_add = utils::addition_cost(input,
-                                                          job_rank,
-                                                          vehicle,
-                                                          current_r.route,
-                                                          r);
-
-            double current_cost =
-              static_cast<double>(current_add.cost) -
-              lambda * static_cast<double>(regrets[v][job_rank]);
-
-            if (current_cost < best_cost and
-                (vehicle.ok_for_travel_time(current_route_duration +
-                                            current_add.duration)) and
-                current_r
-                  .is_valid_addition_for_capacity(input,
-                                                  input.jobs[job_rank].pickup,
-                                                  input.jobs[job_rank].delivery,
-                                                  r) and
-                current_r.is_valid_addition_for_tw(input, job_rank, r)) {
-              best_cost = current_cost;
-              best_job_rank = job_rank;
-              best_r = r;
-              best_duration_addition = current_add.duration;
-            }
+          const double regret =
+            lambda * static_cast<double>(regrets[v][job_rank]);
+          const auto& insertion =
+            insertion_cache.best_insertion(job_rank,
+                                           regret,
+                                           current_route_duration);
+
+          if (insertion.cost < best_cost) {
+            best_cost = insertion.cost;
+            best_job_rank = job_rank;
+            best_r = insertion.rank;
+            best_duration_addition = insertion.duration;
           }
         }
 
@@ -314,7 +220,9 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
           std::vector<unsigned char> valid_delivery_insertions(
             current_r.route.size() + 1);
 
-          for (unsigned d_rank = 0; d_rank <= current_r.route.size();
+          const auto d_tw_ranks =
+            current_r.tw_insertion_ranks(input, job_rank + 1);
+          for (unsigned d_rank = d_tw_ranks.first; d_rank < d_tw_ranks.second;
                ++d_rank) {
             d_adds[d_rank] = utils::addition_cost(input,
                                                   job_rank + 1,
@@ -327,7 +235,9 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
                                                                   d_rank);
           }
 
-          for (Index pickup_r = 0; pickup_r <= current_r.size(); ++pickup_r) {
+          const auto p_tw_ranks = current_r.tw_insertion_ranks(input, job_rank);
+          for (Index pickup_r = p_tw_ranks.first; pickup_r < p_tw_ranks.second;
+               ++pickup_r) {
             const auto p_add = utils::addition_cost(input,
                                                     job_rank,
                                                     vehicle,
@@ -349,7 +259,7 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
             std::vector<Index> modified_with_pd({job_rank});
             Amount modified_delivery = input.zero_amount();
 
-            for (Index delivery_r = pickup_r; delivery_r <= current_r.size();
+            for (Index delivery_r = pickup_r; delivery_r < d_tw_ranks.second;
                  ++delivery_r) {
               // Update state variables along the way before potential
               // early abort.
@@ -427,6 +337,7 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
       if (best_cost < std::numeric_limits<double>::max()) {
         if (input.jobs[best_job_rank].type == JOB_TYPE::SINGLE) {
           current_r.add(input, best_job_rank, best_r);
+          insertion_cache.update(best_r, best_r, 1);
           unassigned.erase(best_job_rank);
           keep_going = true;
         }
@@ -443,6 +354,7 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
                             modified_with_pd.end(),
                             best_pickup_r,
                             best_delivery_r);
+          insertion_cache.update(best_pickup_r, best_delivery_r, 2);
           unassigned.erase(best_job_rank);
           unassigned.erase(best_job_rank + 1);
           keep_going = true;
@@ -458,9 +370,11 @@ T basic(const Input& input, INIT init, double lambda, SORT sort) {
 
 template <class T>
 T dynamic_vehicle_choice(const Input& input,
+                         const HeuristicContext& context,
                          INIT init,
                          double lambda,
-                         SORT sort) {
+                         SORT sort,
+                         const CancellationToken& cancellation) {
   const auto nb_vehicles = input.vehicles.size();
   T routes;
   for (Index v = 0; v < nb_vehicles; ++v) {
@@ -475,9 +389,10 @@ T dynamic_vehicle_choice(const Input& input,
   std::vector<Index> vehicles_ranks(nb_vehicles);
   std::iota(vehicles_ranks.begin(), vehicles_ranks.end(), 0);
 
-  auto evals = get_jobs_vehicles_evals(input);
+  const auto& evals = context.evals();
 
-  while (!vehicles_ranks.empty() and !unassigned.empty()) {
+  while (!vehicles_ranks.empty() and !unassigned.empty() and
+         !cancellation.is_cancelled()) {
     // For any unassigned job at j, jobs_min_costs[j]
     // (resp. jobs_second_min_costs[j]) holds the min cost
     // (resp. second min cost) of picking the job in an empty route
@@ -688,8 +603,12 @@ T dynamic_vehicle_choice(const Input& input,
       }
     }
 
+    InsertionCache<typename T::value_type> insertion_cache(input,
+                                                           v_rank,
+                                                           current_r);
+
     bool keep_going = true;
-    while (keep_going) {
+    while (keep_going and !cancellation.is_cancelled()) {
       keep_going = false;
       double best_cost = std::numeric_limits<double>::max();
       Index best_job_rank = 0;
@@ -710,31 +629,18 @@ T dynamic_vehicle_choice(const Input& input,
 
         if (input.jobs[job_rank].type == JOB_TYPE::SINGLE and
             current_r.size() + 1 <= vehicle.max_tasks) {
-          for (Index r = 0; r <= current_r.size(); ++r) {
-            const auto current_add = utils::addition_cost(input,
-                                                          job_rank,
-                                                          vehicle,
-                                                          current_r.route,
-                                                          r);
-
-            double current_cost =
-              static_cast<double>(current_add.cost) -
-              lambda * static_cast<double>(regrets[job_rank]);
-
-            if (current_cost < best_cost and
-                (vehicle.ok_for_travel_time(current_route_duration +
-                                            current_add.duration)) and
-                current_r
-                  .is_valid_addition_for_capacity(input,
-                                                  input.jobs[job_rank].pickup,
-                                                  input.jobs[job_rank].delivery,
-                                                  r) and
-                current_r.is_valid_addition_for_tw(input, job_rank, r)) {
-              best_cost = current_cost;
-              best_job_rank = job_rank;
-              best_r = r;
-              best_duration_addition = current_add.duration;
-            }
+          const double regret =
+            lambda * static_cast<double>(regrets[job_rank]);
+          const auto& insertion =
+            insertion_cache.best_insertion(job_rank,
+                                           regret,
+                                           current_route_duration);
+
+          if (insertion.cost < best_cost) {
+            best_cost = insertion.cost;
+            best_job_rank = job_rank;
+            best_r = insertion.rank;
+            best_duration_addition = insertion.duration;
           }
         }
 
@@ -745,7 +651,9 @@ T dynamic_vehicle_choice(const Input& input,
           std::vector<unsigned char> valid_delivery_insertions(
             current_r.route.size() + 1);
 
-          for (unsigned d_rank = 0; d_rank <= current_r.route.size();
+          const auto d_tw_ranks =
+            current_r.tw_insertion_ranks(input, job_rank + 1);
+          for (unsigned d_rank = d_tw_ranks.first; d_rank < d_tw_ranks.second;
                ++d_rank) {
             d_adds[d_rank] = utils::addition_cost(input,
                                                   job_rank + 1,
@@ -758,7 +666,9 @@ T dynamic_vehicle_choice(const Input& input,
                                                                   d_rank);
           }
 
-          for (Index pickup_r = 0; pickup_r <= current_r.size(); ++pickup_r) {
+          const auto p_tw_ranks = current_r.tw_insertion_ranks(input, job_rank);
+          for (Index pickup_r = p_tw_ranks.first; pickup_r < p_tw_ranks.second;
+               ++pickup_r) {
             const auto p_add = utils::addition_cost(input,
                                                     job_rank,
                                                     vehicle,
@@ -780,7 +690,7 @@ T dynamic_vehicle_choice(const Input& input,
             std::vector<Index> modified_with_pd({job_rank});
             Amount modified_delivery = input.zero_amount();
 
-            for (Index delivery_r = pickup_r; delivery_r <= current_r.size();
+            for (Index delivery_r = pickup_r; delivery_r < d_tw_ranks.second;
                  ++delivery_r) {
               // Update state variables along the way before potential
               // early abort.
@@ -855,6 +765,7 @@ T dynamic_vehicle_choice(const Input& input,
       if (best_cost < std::numeric_limits<double>::max()) {
         if (input.jobs[best_job_rank].type == JOB_TYPE::SINGLE) {
           current_r.add(input, best_job_rank, best_r);
+          insertion_cache.update(best_r, best_r, 1);
           unassigned.erase(best_job_rank);
           keep_going = true;
         }
@@ -871,6 +782,7 @@ T dynamic_vehicle_choice(const Input& input,
                             modified_with_pd.end(),
                             best_pickup_r,
                             best_delivery_r);
+          insertion_cache.update(best_pickup_r, best_delivery_r, 2);
           unassigned.erase(best_job_rank);
           unassigned.erase(best_job_rank + 1);
           keep_going = true;
@@ -884,6 +796,571 @@ T dynamic_vehicle_choice(const Input& input,
   return routes;
 }
 
+// Add job j (along with matching delivery for a pickup) to route
+// based on insertion, then notify route insertion cache.
+template <class Route>
+void apply_insertion(const Input& input,
+                     Route& route,
+                     InsertionCache<Route>& insertion_cache,
+                     Index j,
+                     const ls::RouteInsertion& insertion) {
+  if (input.jobs[j].type == JOB_TYPE::SINGLE) {
+    route.add(input, j, insertion.single_rank);
+    insertion_cache.update(insertion.single_rank, insertion.single_rank, 1);
+  } else {
+    assert(input.jobs[j].type == JOB_TYPE::PICKUP);
+
+    std::vector<Index> modified_with_pd({j});
+    std::copy(route.route.begin() + insertion.pickup_rank,
+              route.route.begin() + insertion.delivery_rank,
+              std::back_inserter(modified_with_pd));
+    modified_with_pd.push_back(j + 1);
+
+    route.replace(input,
+                  insertion.delivery,
+                  modified_with_pd.begin(),
+                  modified_with_pd.end(),
+                  insertion.pickup_rank,
+                  insertion.delivery_rank);
+    insertion_cache.update(insertion.pickup_rank, insertion.delivery_rank, 2);
+  }
+}
+
+// Best insertion for job j in route, relying on insertion_cache for
+// single jobs. Only valid if sol_state holds route evaluation and
+// insertion ranks for route.
+template <class Route>
+ls::RouteInsertion best_route_insertion(const Input& input,
+                                        const utils::SolutionState& sol_state,
+                                        InsertionCache<Route>& insertion_cache,
+                                        Index j,
+                                        Index v,
+                                        const Route& route) {
+  const bool is_pickup = (input.jobs[j].type == JOB_TYPE::PICKUP);
+
+  if (!input.vehicle_ok_with_job(v, j) or
+      route.size() + (is_pickup ? 2 : 1) > input.vehicles[v].max_tasks) {
+    return ls::RouteInsertion(input.get_amount_size());
+  }
+
+  if (is_pickup) {
+    return ls::compute_best_insertion(input, sol_state, j, v, route);
+  }
+
+  ls::RouteInsertion insertion(input.get_amount_size());
+  const auto& single =
+    insertion_cache.best_insertion(j, 0, sol_state.route_evals[v].duration);
+  if (single.cost < std::numeric_limits<double>::max()) {
+    insertion.eval = Eval(static_cast<Cost>(single.cost), single.duration);
+    insertion.delivery = input.jobs[j].delivery;
+    insertion.single_rank = single.rank;
+  }
+  return insertion;
+}
+
+template <class T>
+T regret_insertion(const Input& input,
+                   const HeuristicContext& context,
+                   double lambda,
+                   SORT sort,
+                   unsigned nb_threads,
+                   const CancellationToken& cancellation) {
+  const auto nb_vehicles = input.vehicles.size();
+  T routes;
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    routes.emplace_back(input, v, input.zero_amount().size());
+  }
+
+  // Routes are considered in that order, which only matters to
+  // decide between equivalent insertions.
+  const auto& vehicles_ranks = context.vehicles_ranks(sort);
+
+  // Only the parts required to compute insertions are maintained.
+  // Narrowing insertion ranks based on time windows would require a
+  // pass over all jobs and route tasks upon each route change, so
+  // all ranks are considered and validity is checked for each
+  // insertion instead.
+  utils::SolutionState sol_state(input);
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    sol_state.set_insertion_ranks(static_cast<const RawRoute&>(routes[v]), v);
+    sol_state.update_route_eval(routes[v].route, v);
+  }
+
+  // Single jobs insertions only have to be re-evaluated around
+  // modified ranks upon route changes.
+  using Route = typename T::value_type;
+  std::vector<InsertionCache<Route>> insertion_caches;
+  insertion_caches.reserve(nb_vehicles);
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    insertion_caches.emplace_back(input, v, routes[v]);
+  }
+
+  // Deliveries are inserted along with matching pickups.
+  std::vector<Index> unassigned;
+  for (Index j = 0; j < input.jobs.size(); ++j) {
+    if (input.jobs[j].type != JOB_TYPE::DELIVERY) {
+      unassigned.push_back(j);
+    }
+  }
+
+  // insertions[j][i] holds the best insertion for job j in route for
+  // vehicle at rank vehicles_ranks[i]. For job j, cheapest[j]
+  // (resp. second_cheapest[j]) is the i value with the cheapest
+  // (resp. second cheapest) valid insertion.
+  constexpr auto NO_ROUTE = std::numeric_limits<std::size_t>::max();
+  std::vector<std::vector<ls::RouteInsertion>>
+    insertions(input.jobs.size(),
+               std::vector<ls::RouteInsertion>(nb_vehicles,
+                                               ls::RouteInsertion(
+                                                 input.get_amount_size())));
+  std::vector<std::size_t> cheapest(input.jobs.size(), NO_ROUTE);
+  std::vector<std::size_t> second_cheapest(input.jobs.size(), NO_ROUTE);
+
+  // Missing alternative routes result in a huge regret cost so that
+  // jobs with a single valid route are inserted first.
+  auto insertion_cost = [&](Index j, std::size_t i) {
+    return (i == NO_ROUTE) ? NO_EVAL.cost : insertions[j][i].eval.cost;
+  };
+
+  auto evaluate = [&](Index j, std::size_t i) {
+    const auto v = vehicles_ranks[i];
+    const auto& current_r = routes[v];
+
+    insertions[j][i] = best_route_insertion(input,
+                                            sol_state,
+                                            insertion_caches[v],
+                                            j,
+                                            v,
+                                            current_r);
+    if (insertions[j][i].eval != NO_EVAL and current_r.empty()) {
+      insertions[j][i].eval.cost += input.vehicles[v].fixed_cost();
+    }
+  };
+
+  auto set_cheapest = [&](Index j) {
+    cheapest[j] = NO_ROUTE;
+    second_cheapest[j] = NO_ROUTE;
+    for (std::size_t i = 0; i < nb_vehicles; ++i) {
+      const auto cost = insertions[j][i].eval.cost;
+      if (cost < insertion_cost(j, cheapest[j])) {
+        second_cheapest[j] = cheapest[j];
+        cheapest[j] = i;
+      } else if (cost < insertion_cost(j, second_cheapest[j])) {
+        second_cheapest[j] = i;
+      }
+    }
+  };
+
+  auto update_cheapest = [&](Index j, std::size_t i) {
+    if (i == cheapest[j] or i == second_cheapest[j]) {
+      // Current values may have been replaced with a worse one.
+      set_cheapest(j);
+      return;
+    }
+
+    const auto cost = insertions[j][i].eval.cost;
+    if (cost < insertion_cost(j, cheapest[j])) {
+      second_cheapest[j] = cheapest[j];
+      cheapest[j] = i;
+    } else if (cost < insertion_cost(j, second_cheapest[j])) {
+      second_cheapest[j] = i;
+    }
+  };
+
+  // Apply f to all unassigned jobs, splitting them across threads
+  // when expected work is worth it, based on the number of insertion
+  // ranks to evaluate. Each job is handled by a single thread and all
+  // other data is only read.
+  auto for_all_unassigned = [&](const auto& f, std::size_t nb_ranks) {
+    constexpr std::size_t min_ranks_per_thread = 100000;
+    const std::size_t nb_ranges =
+      std::min<std::size_t>(nb_threads,
+                            unassigned.size() * nb_ranks /
+                              min_ranks_per_thread);
+
+    if (nb_ranges <= 1) {
+      std::for_each(unassigned.begin(), unassigned.end(), f);
+      return;
+    }
+
+    std::exception_ptr ep = nullptr;
+    std::mutex ep_m;
+
+    auto run_on_range = [&](std::size_t begin, std::size_t end) {
+      try {
+        std::for_each(unassigned.begin() + begin, unassigned.begin() + end, f);
+      } catch (...) {
+        ep_m.lock();
+        ep = std::current_exception();
+        ep_m.unlock();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t r = 0; r < nb_ranges; ++r) {
+      threads.emplace_back(run_on_range,
+                           r * unassigned.size() / nb_ranges,
+                           (r + 1) * unassigned.size() / nb_ranges);
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    if (ep != nullptr) {
+      std::rethrow_exception(ep);
+    }
+  };
+
+  for_all_unassigned(
+    [&](Index j) {
+      for (std::size_t i = 0; i < nb_vehicles; ++i) {
+        evaluate(j, i);
+      }
+      set_cheapest(j);
+    },
+    nb_vehicles);
+
+  while (!unassigned.empty() and !cancellation.is_cancelled()) {
+    Priority best_priority = 0;
+    double best_cost = std::numeric_limits<double>::max();
+    std::size_t best_unassigned_rank = 0;
+    std::size_t best_i = 0;
+
+    for (std::size_t u = 0; u < unassigned.size(); ++u) {
+      const auto j = unassigned[u];
+      const auto job_priority = input.jobs[j].priority;
+
+      if (job_priority < best_priority) {
+        // Insert higher priority jobs first.
+        continue;
+      }
+
+      // Using any other route than the two cheapest ones can't be a
+      // better choice based on cost of addition and regret cost of
+      // not adding.
+      for (const auto i : {std::min(cheapest[j], second_cheapest[j]),
+                           std::max(cheapest[j], second_cheapest[j])}) {
+        if (i == NO_ROUTE) {
+          continue;
+        }
+
+        const auto regret_cost = (i == cheapest[j])
+                                   ? insertion_cost(j, second_cheapest[j])
+                                   : insertion_cost(j, cheapest[j]);
+
+        const double current_cost =
+          static_cast<double>(insertions[j][i].eval.cost) -
+          lambda * static_cast<double>(regret_cost);
+
+        if ((job_priority > best_priority) or
+            (job_priority == best_priority and current_cost < best_cost)) {
+          best_priority = job_priority;
+          best_cost = current_cost;
+          best_unassigned_rank = u;
+          best_i = i;
+        }
+      }
+    }
+
+    if (best_cost >= std::numeric_limits<double>::max()) {
+      // No more valid insertion.
+      break;
+    }
+
+    const auto best_job_rank = unassigned[best_unassigned_rank];
+    const auto best_route = vehicles_ranks[best_i];
+    const auto& best_insertion = insertions[best_job_rank][best_i];
+    auto& current_r = routes[best_route];
+
+    apply_insertion(input,
+                    current_r,
+                    insertion_caches[best_route],
+                    best_job_rank,
+                    best_insertion);
+    unassigned.erase(unassigned.begin() + best_unassigned_rank);
+
+    // Only insertions in modified route have to be re-evaluated.
+    sol_state.update_route_eval(current_r.route, best_route);
+    sol_state.set_insertion_ranks(static_cast<const RawRoute&>(current_r),
+                                  best_route);
+
+    for_all_unassigned(
+      [&](Index j) {
+        evaluate(j, best_i);
+        update_cheapest(j, best_i);
+      },
+      current_r.size() + 1);
+  }
+
+  return routes;
+}
+
+template <class T>
+T clustering(const Input& input,
+             const HeuristicContext& context,
+             SORT sort,
+             unsigned nb_threads,
+             const CancellationToken& cancellation) {
+  const auto nb_vehicles = input.vehicles.size();
+  T routes;
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    routes.emplace_back(input, v, input.zero_amount().size());
+  }
+
+  const auto& vehicles_ranks = context.vehicles_ranks(sort);
+  const auto& evals = context.evals();
+
+  // Amount bound used to check a cluster fits in a vehicle, whatever
+  // the ordering of its jobs.
+  auto job_load = [&](Index j) {
+    Amount load(input.jobs[j].pickup);
+    if (input.jobs[j].type == JOB_TYPE::SINGLE) {
+      load += input.jobs[j].delivery;
+    }
+    return load;
+  };
+
+  auto nb_tasks = [&](Index j) {
+    return (input.jobs[j].type == JOB_TYPE::PICKUP) ? 2 : 1;
+  };
+
+  // Cost to go back and forth between job locations for vehicle at
+  // rank v. Pickup location is used for shipments.
+  auto round_trip_cost = [&](Index v, Index from, Index to) {
+    const auto& vehicle = input.vehicles[v];
+    const auto from_index = input.jobs[from].index();
+    const auto to_index = input.jobs[to].index();
+    return vehicle.cost(from_index, to_index) +
+           vehicle.cost(to_index, from_index);
+  };
+
+  std::vector<std::vector<Index>> clusters(nb_vehicles);
+  std::vector<Amount> clusters_load(nb_vehicles, input.zero_amount());
+  std::vector<std::size_t> clusters_tasks(nb_vehicles, 0);
+  std::vector<bool> clustered(input.jobs.size(), false);
+
+  auto fits = [&](Index v, Index j) {
+    const auto& vehicle = input.vehicles[v];
+    return input.vehicle_ok_with_job(v, j) and
+           clusters_tasks[v] + nb_tasks(j) <= vehicle.max_tasks and
+           clusters_load[v] + job_load(j) <= vehicle.capacity;
+  };
+
+  auto add_to_cluster = [&](Index v, Index j) {
+    clusters[v].push_back(j);
+    clusters_load[v] += job_load(j);
+    clusters_tasks[v] += nb_tasks(j);
+    clustered[j] = true;
+  };
+
+  // Fill clusters one vehicle at a time, starting with the job that
+  // is the furthest away from vehicle then adding jobs closest to
+  // that seed first, higher priority jobs first. Remaining vehicles
+  // are only used once capacity or max tasks are reached, as with a
+  // sweep along distance to seed.
+  std::vector<Index> candidates;
+  std::vector<Cost> seed_costs(input.jobs.size());
+  for (const auto v : vehicles_ranks) {
+    if (cancellation.is_cancelled()) {
+      break;
+    }
+
+    Cost furthest_cost = 0;
+    std::optional<Index> seed;
+    candidates.clear();
+    for (Index j = 0; j < input.jobs.size(); ++j) {
+      if (input.jobs[j].type == JOB_TYPE::DELIVERY or clustered[j] or
+          !fits(v, j)) {
+        continue;
+      }
+      candidates.push_back(j);
+
+      if (!seed.has_value() or furthest_cost < evals[j][v].cost) {
+        furthest_cost = evals[j][v].cost;
+        seed = j;
+      }
+    }
+
+    if (!seed.has_value()) {
+      continue;
+    }
+
+    for (const auto j : candidates) {
+      seed_costs[j] = round_trip_cost(v, seed.value(), j);
+    }
+    std::stable_sort(candidates.begin(),
+                     candidates.end(),
+                     [&](const Index lhs, const Index rhs) {
+                       const auto lhs_priority = input.jobs[lhs].priority;
+                       const auto rhs_priority = input.jobs[rhs].priority;
+                       return lhs_priority > rhs_priority or
+                              (lhs_priority == rhs_priority and
+                               seed_costs[lhs] < seed_costs[rhs]);
+                     });
+
+    add_to_cluster(v, seed.value());
+    for (const auto j : candidates) {
+      if (!clustered[j] and fits(v, j)) {
+        add_to_cluster(v, j);
+      }
+    }
+  }
+
+  std::vector<Index> leftovers;
+  for (Index j = 0; j < input.jobs.size(); ++j) {
+    if (input.jobs[j].type != JOB_TYPE::DELIVERY and !clustered[j]) {
+      leftovers.push_back(j);
+    }
+  }
+
+  // Only the parts required to compute insertions are maintained, see
+  // regret_insertion. Each route only touches its own entries so
+  // routes are built independently across threads.
+  utils::SolutionState sol_state(input);
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    sol_state.set_insertion_ranks(static_cast<const RawRoute&>(routes[v]), v);
+    sol_state.update_route_eval(routes[v].route, v);
+  }
+
+  using Route = typename T::value_type;
+  std::vector<std::vector<Index>> routes_leftovers(nb_vehicles);
+
+  // Build route for vehicle at rank v by cheapest insertion of
+  // cluster jobs, higher priority first.
+  auto build_route = [&](Index v) {
+    auto& current_r = routes[v];
+    InsertionCache<Route> insertion_cache(input, v, current_r);
+    auto& candidates = clusters[v];
+
+    while (!candidates.empty() and !cancellation.is_cancelled()) {
+      Priority best_priority = 0;
+      std::optional<std::size_t> best_c;
+      ls::RouteInsertion best_insertion(input.get_amount_size());
+
+      for (std::size_t c = 0; c < candidates.size(); ++c) {
+        const auto j = candidates[c];
+        const auto job_priority = input.jobs[j].priority;
+        if (job_priority < best_priority) {
+          continue;
+        }
+
+        auto insertion = best_route_insertion(input,
+                                              sol_state,
+                                              insertion_cache,
+                                              j,
+                                              v,
+                                              current_r);
+        if (insertion.eval != NO_EVAL and
+            (!best_c.has_value() or job_priority > best_priority or
+             insertion.eval.cost < best_insertion.eval.cost)) {
+          best_priority = job_priority;
+          best_c = c;
+          best_insertion = std::move(insertion);
+        }
+      }
+
+      if (!best_c.has_value()) {
+        break;
+      }
+
+      apply_insertion(input,
+                      current_r,
+                      insertion_cache,
+                      candidates[best_c.value()],
+                      best_insertion);
+      candidates.erase(candidates.begin() + best_c.value());
+
+      sol_state.update_route_eval(current_r.route, v);
+      sol_state.set_insertion_ranks(static_cast<const RawRoute&>(current_r),
+                                    v);
+    }
+
+    routes_leftovers[v] = std::move(candidates);
+  };
+
+  std::vector<std::vector<Index>> thread_vehicles(
+    std::min<std::size_t>(nb_threads, nb_vehicles));
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    thread_vehicles[v % thread_vehicles.size()].push_back(v);
+  }
+
+  std::exception_ptr ep = nullptr;
+  std::mutex ep_m;
+
+  auto run_build = [&](const std::vector<Index>& vehicles) {
+    try {
+      std::for_each(vehicles.begin(), vehicles.end(), build_route);
+    } catch (...) {
+      ep_m.lock();
+      ep = std::current_exception();
+      ep_m.unlock();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (const auto& vehicles : thread_vehicles) {
+    threads.emplace_back(run_build, std::cref(vehicles));
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  if (ep != nullptr) {
+    std::rethrow_exception(ep);
+  }
+
+  for (const auto& route_leftovers : routes_leftovers) {
+    leftovers.insert(leftovers.end(),
+                     route_leftovers.begin(),
+                     route_leftovers.end());
+  }
+
+  // Jobs that did not fit in their cluster are inserted at their best
+  // place across all routes, if any.
+  std::vector<InsertionCache<Route>> insertion_caches;
+  insertion_caches.reserve(nb_vehicles);
+  for (Index v = 0; v < nb_vehicles; ++v) {
+    insertion_caches.emplace_back(input, v, routes[v]);
+  }
+
+  for (const auto j : leftovers) {
+    if (cancellation.is_cancelled()) {
+      break;
+    }
+
+    std::optional<Index> best_v;
+    ls::RouteInsertion best_insertion(input.get_amount_size());
+
+    for (const auto v : vehicles_ranks) {
+      auto insertion = best_route_insertion(input,
+                                            sol_state,
+                                            insertion_caches[v],
+                                            j,
+                                            v,
+                                            routes[v]);
+      if (insertion.eval != NO_EVAL and routes[v].empty()) {
+        insertion.eval.cost += input.vehicles[v].fixed_cost();
+      }
+      if (insertion.eval.cost < best_insertion.eval.cost) {
+        best_v = v;
+        best_insertion = std::move(insertion);
+      }
+    }
+
+    if (best_v.has_value()) {
+      const auto v = best_v.value();
+      apply_insertion(input, routes[v], insertion_caches[v], j, best_insertion);
+      sol_state.update_route_eval(routes[v].route, v);
+      sol_state.set_insertion_ranks(static_cast<const RawRoute&>(routes[v]),
+                                    v);
+    }
+  }
+
+  return routes;
+}
+
 template <class T> T initial_routes(const Input& input) {
   T routes;
   for (Index v = 0; v < input.vehicles.size(); ++v) {
@@ -990,23 +1467,219 @@ template <class T> T initial_routes(const Input& input) {
   return routes;
 }
 
+template <class T> T repair_routes(const Input& input) {
+  // Only routes with time windows need to be built along the way in
+  // order to check additions.
+  const bool check_tw = input.has_TW();
+
+  T routes;
+  for (Index v = 0; v < input.vehicles.size(); ++v) {
+    routes.emplace_back(input, v, input.zero_amount().size());
+    auto& current_r = routes.back();
+
+    const auto& vehicle = input.vehicles[v];
+    const auto& previous_route = input.get_previous_route(v);
+
+    std::vector<Index> job_ranks;
+    std::unordered_set<Index> dropped_ranks;
+    bool pending_pickups = true;
+
+    while (pending_pickups) {
+      // Keep previous jobs in the same order, skipping those that
+      // would make the route invalid. Validity is checked
+      // incrementally upon adding each job at the end of the kept
+      // ones.
+      job_ranks.clear();
+      std::unordered_set<Index> expected_delivery_ranks;
+      if (!current_r.empty()) {
+        current_r =
+          typename T::value_type(input, v, input.zero_amount().size());
+      }
+
+      // Startup load is the sum of deliveries for (single) jobs. Load
+      // at any step is then the startup load plus the pickups minus
+      // the deliveries so far, so checking capacity only requires
+      // the highest such offset across steps for each component.
+      Amount single_jobs_deliveries(input.zero_amount());
+      Amount load_offset(input.zero_amount());
+      Amount max_load_offset(input.zero_amount());
+      Duration duration = 0;
+
+      // Kept jobs not yet added to current_r. Checking time windows
+      // goes through all of them while adding them to current_r is
+      // linear in route size, so they are only added once there are
+      // enough of them, and only as complete shipments.
+      std::vector<Index> tail;
+      Amount tail_deliveries(input.zero_amount());
+
+      for (const auto job_rank : previous_route) {
+        if (dropped_ranks.find(job_rank) != dropped_ranks.end() or
+            !input.vehicle_ok_with_job(v, job_rank)) {
+          continue;
+        }
+
+        const auto& job = input.jobs[job_rank];
+        if (job.type == JOB_TYPE::DELIVERY and
+            expected_delivery_ranks.find(job_rank) ==
+              expected_delivery_ranks.end()) {
+          // Matching pickup is not part of the route.
+          continue;
+        }
+
+        if (vehicle.max_tasks <= job_ranks.size()) {
+          continue;
+        }
+
+        const auto& job_delivery = (job.type == JOB_TYPE::SINGLE)
+                                     ? job.delivery
+                                     : input.zero_amount();
+        const Amount new_load_offset = load_offset + job.pickup - job.delivery;
+        bool valid = true;
+        for (std::size_t i = 0; valid and i < vehicle.capacity.size(); ++i) {
+          valid = single_jobs_deliveries[i] + job_delivery[i] +
+                    std::max(max_load_offset[i], new_load_offset[i]) <=
+                  vehicle.capacity[i];
+        }
+        if (!valid) {
+          continue;
+        }
+
+        const auto add = utils::addition_cost(input,
+                                              job_rank,
+                                              vehicle,
+                                              job_ranks,
+                                              job_ranks.size());
+        if (!vehicle.ok_for_travel_time(duration + add.duration)) {
+          continue;
+        }
+
+        tail.push_back(job_rank);
+        if (check_tw and
+            !current_r.is_valid_addition_for_tw(input,
+                                                tail_deliveries + job_delivery,
+                                                tail.begin(),
+                                                tail.end(),
+                                                current_r.size(),
+                                                current_r.size())) {
+          tail.pop_back();
+          continue;
+        }
+
+        job_ranks.push_back(job_rank);
+        tail_deliveries += job_delivery;
+        single_jobs_deliveries += job_delivery;
+        load_offset = new_load_offset;
+        for (std::size_t i = 0; i < load_offset.size(); ++i) {
+          max_load_offset[i] = std::max(max_load_offset[i], load_offset[i]);
+        }
+        duration += add.duration;
+
+        if (job.type == JOB_TYPE::PICKUP) {
+          expected_delivery_ranks.insert(job_rank + 1);
+        }
+        if (job.type == JOB_TYPE::DELIVERY) {
+          expected_delivery_ranks.erase(job_rank);
+        }
+
+        if (check_tw and expected_delivery_ranks.empty() and
+            current_r.size() <= tail.size() * tail.size()) {
+          current_r.replace(input,
+                            tail_deliveries,
+                            tail.begin(),
+                            tail.end(),
+                            current_r.size(),
+                            current_r.size());
+          tail.clear();
+          tail_deliveries = input.zero_amount();
+        }
+      }
+
+      // Pickups whose matching delivery could not be kept are
+      // dropped before trying again.
+      pending_pickups = !expected_delivery_ranks.empty();
+      for (const auto delivery_rank : expected_delivery_ranks) {
+        dropped_ranks.insert(delivery_rank - 1);
+      }
+
+      if (!pending_pickups and !tail.empty()) {
+        current_r.replace(input,
+                          tail_deliveries,
+                          tail.begin(),
+                          tail.end(),
+                          current_r.size(),
+                          current_r.size());
+      }
+    }
+  }
+
+  return routes;
+}
+
 using RawSolution = std::vector<RawRoute>;
 using TWSolution = std::vector<TWRoute>;
 
-template RawSolution
-basic(const Input& input, INIT init, double lambda, SORT sort);
+template RawSolution basic(const Input& input,
+                           const HeuristicContext& context,
+                           INIT init,
+                           double lambda,
+                           SORT sort,
+                           const CancellationToken& cancellation);
 
 template RawSolution
-dynamic_vehicle_choice(const Input& input, INIT init, double lambda, SORT sort);
+dynamic_vehicle_choice(const Input& input,
+                       const HeuristicContext& context,
+                       INIT init,
+                       double lambda,
+                       SORT sort,
+                       const CancellationToken& cancellation);
+
+template RawSolution regret_insertion(const Input& input,
+                                      const HeuristicContext& context,
+                                      double lambda,
+                                      SORT sort,
+                                      unsigned nb_threads,
+                                      const CancellationToken& cancellation);
+
+template RawSolution clustering(const Input& input,
+                                const HeuristicContext& context,
+                                SORT sort,
+                                unsigned nb_threads,
+                                const CancellationToken& cancellation);
 
 template RawSolution initial_routes(const Input& input);
 
-template TWSolution
-basic(const Input& input, INIT init, double lambda, SORT sort);
+template RawSolution repair_routes(const Input& input);
+
+template TWSolution basic(const Input& input,
+                          const HeuristicContext& context,
+                          INIT init,
+                          double lambda,
+                          SORT sort,
+                          const CancellationToken& cancellation);
 
 template TWSolution
-dynamic_vehicle_choice(const Input& input, INIT init, double lambda, SORT sort);
+dynamic_vehicle_choice(const Input& input,
+                       const HeuristicContext& context,
+                       INIT init,
+                       double lambda,
+                       SORT sort,
+                       const CancellationToken& cancellation);
+
+template TWSolution regret_insertion(const Input& input,
+                                     const HeuristicContext& context,
+                                     double lambda,
+                                     SORT sort,
+                                     unsigned nb_threads,
+                                     const CancellationToken& cancellation);
+
+template TWSolution clustering(const Input& input,
+                               const HeuristicContext& context,
+                               SORT sort,
+                               unsigned nb_threads,
+                               const CancellationToken& cancellation);
 
 template TWSolution initial_routes(const Input& input);
 
+template TWSolution repair_routes(const Input& input);
+
 } // namespace vroom::heuristics
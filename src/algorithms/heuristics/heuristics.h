@@ -10,24 +10,62 @@ All rights reserved (see LICENSE).
 
 */
 
+#include "algorithms/heuristics/heuristic_context.h"
 #include "structures/vroom/input/input.h"
 
 namespace vroom::heuristics {
 
-// Implementation of a variant of the Solomon I1 heuristic.
+// Implementation of a variant of the Solomon I1 heuristic. When
+// cancelled, routes built so far are returned.
 template <class T>
-T basic(const Input& input, INIT init, double lambda, SORT sort);
+T basic(const Input& input,
+        const HeuristicContext& context,
+        INIT init,
+        double lambda,
+        SORT sort,
+        const CancellationToken& cancellation = CancellationToken());
 
 // Adjusting the above for situation with heterogeneous fleet.
 template <class T>
 T dynamic_vehicle_choice(const Input& input,
+                         const HeuristicContext& context,
                          INIT init,
                          double lambda,
-                         SORT sort);
+                         SORT sort,
+                         const CancellationToken& cancellation =
+                           CancellationToken());
+
+// Build all routes at the same time by repeatedly picking the job
+// insertion with the best trade-off between its cost and the regret
+// of not using the cheapest alternative route. Insertions are
+// re-evaluated across nb_threads threads.
+template <class T>
+T regret_insertion(const Input& input,
+                   const HeuristicContext& context,
+                   double lambda,
+                   SORT sort,
+                   unsigned nb_threads,
+                   const CancellationToken& cancellation =
+                     CancellationToken());
+
+// Split jobs into one cluster per vehicle based on distance to seed
+// jobs and vehicle capacity, then build routes for all clusters
+// independently across nb_threads threads. Meant to provide a quick
+// starting point for large instances.
+template <class T>
+T clustering(const Input& input,
+             const HeuristicContext& context,
+             SORT sort,
+             unsigned nb_threads,
+             const CancellationToken& cancellation = CancellationToken());
 
 // Populate routes with user-defined vehicle steps.
 template <class T> T initial_routes(const Input& input);
 
+// Populate routes with jobs from previous solution, dropping the ones
+// that are no longer valid.
+template <class T> T repair_routes(const Input& input);
+
 } // namespace vroom::heuristics
 
 #endif
@@ -0,0 +1,173 @@
+#ifndef INSERTION_CACHE_H
+#define INSERTION_CACHE_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <limits>
+
+#include "structures/typedefs.h"
+#include "structures/vroom/input/input.h"
+#include "utils/helpers.h"
+
+namespace vroom::heuristics {
+
+struct SingleInsertion {
+  double cost{std::numeric_limits<double>::max()};
+  Index rank{0};
+  Duration duration{0};
+};
+
+// Store best insertion for single jobs in a route that is being
+// built. Adding jobs to a route never makes an invalid insertion
+// valid again and only changes addition costs around modified
+// ranks. So upon a route change, a cached insertion is still the
+// best one unless it became invalid or a better candidate appeared
+// around the change. A full scan of the route is only required in
+// the first case.
+template <class Route> class InsertionCache {
+private:
+  struct Entry {
+    SingleInsertion insertion;
+    unsigned nb_changes{0};
+    bool computed{false};
+  };
+
+  const Input& _input;
+  const Vehicle& _vehicle;
+  const Route& _route;
+  std::vector<Entry> _entries;
+
+  // Describe last route change: jobs in [_first_rank, _last_rank)
+  // have been replaced with a sequence holding _nb_added more jobs.
+  unsigned _nb_changes{0};
+  Index _first_rank{0};
+  Index _last_rank{0};
+  Index _nb_added{0};
+
+  bool is_valid(Index j,
+                Index rank,
+                Duration addition_duration,
+                Duration route_duration) const {
+    return _vehicle.ok_for_travel_time(route_duration + addition_duration) and
+           _route.is_valid_addition_for_capacity(_input,
+                                                 _input.jobs[j].pickup,
+                                                 _input.jobs[j].delivery,
+                                                 rank) and
+           _route.is_valid_addition_for_tw(_input, j, rank);
+  }
+
+  void try_rank(Index j,
+                Index rank,
+                double regret,
+                Duration route_duration,
+                SingleInsertion& best) const {
+    const auto add =
+      utils::addition_cost(_input, j, _vehicle, _route.route, rank);
+    const double cost = static_cast<double>(add.cost) - regret;
+
+    if (cost < best.cost and is_valid(j, rank, add.duration, route_duration)) {
+      best.cost = cost;
+      best.rank = rank;
+      best.duration = add.duration;
+    }
+  }
+
+  SingleInsertion
+  scan_route(Index j, double regret, Duration route_duration) const {
+    SingleInsertion best;
+    const auto tw_ranks = _route.tw_insertion_ranks(_input, j);
+    for (Index r = tw_ranks.first; r < tw_ranks.second; ++r) {
+      try_rank(j, r, regret, route_duration, best);
+    }
+    return best;
+  }
+
+  SingleInsertion update_insertion(Index j,
+                                   SingleInsertion cached,
+                                   double regret,
+                                   Duration route_duration) const {
+    const bool has_cached =
+      (cached.cost < std::numeric_limits<double>::max());
+
+    if (has_cached) {
+      if (_first_rank <= cached.rank and cached.rank <= _last_rank) {
+        // Cached insertion rank no longer exists.
+        return scan_route(j, regret, route_duration);
+      }
+      if (_last_rank < cached.rank) {
+        cached.rank += _nb_added;
+      }
+      if (!is_valid(j, cached.rank, cached.duration, route_duration)) {
+        return scan_route(j, regret, route_duration);
+      }
+    }
+
+    // Candidates are compared in rank order to retain the lowest rank
+    // in case of equal costs, as a full scan would.
+    SingleInsertion best;
+    if (has_cached and cached.rank < _first_rank) {
+      best = cached;
+    }
+    const auto tw_ranks = _route.tw_insertion_ranks(_input, j);
+    const Index last_changed = _last_rank + _nb_added + 1;
+    for (Index r = std::max(_first_rank, tw_ranks.first);
+         r < std::min(last_changed, tw_ranks.second);
+         ++r) {
+      try_rank(j, r, regret, route_duration, best);
+    }
+    if (has_cached and _last_rank + _nb_added < cached.rank and
+        cached.cost < best.cost) {
+      best = cached;
+    }
+
+    return best;
+  }
+
+public:
+  InsertionCache(const Input& input, Index v_rank, const Route& route)
+    : _input(input),
+      _vehicle(input.vehicles[v_rank]),
+      _route(route),
+      _entries(input.jobs.size()) {
+  }
+
+  // Has to be called after each change to the route, where jobs in
+  // [first_rank, last_rank) are replaced with a sequence holding
+  // nb_added more jobs.
+  void update(Index first_rank, Index last_rank, Index nb_added) {
+    ++_nb_changes;
+    _first_rank = first_rank;
+    _last_rank = last_rank;
+    _nb_added = nb_added;
+  }
+
+  // Best valid insertion for single job j, where regret is
+  // subtracted from addition cost. Resulting cost is max double if
+  // no valid insertion exists.
+  const SingleInsertion&
+  best_insertion(Index j, double regret, Duration route_duration) {
+    auto& entry = _entries[j];
+
+    if (!entry.computed or entry.nb_changes + 1 < _nb_changes) {
+      entry.insertion = scan_route(j, regret, route_duration);
+    } else if (entry.nb_changes + 1 == _nb_changes) {
+      entry.insertion =
+        update_insertion(j, entry.insertion, regret, route_duration);
+    }
+    entry.computed = true;
+    entry.nb_changes = _nb_changes;
+
+    return entry.insertion;
+  }
+};
+
+} // namespace vroom::heuristics
+
+#endif
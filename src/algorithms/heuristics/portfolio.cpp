@@ -0,0 +1,187 @@
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include "algorithms/heuristics/portfolio.h"
+
+namespace vroom::heuristics {
+
+InstanceFeatures::InstanceFeatures(const Input& input) {
+  const auto amount_size = input.get_amount_size();
+
+  Amount jobs_amount(input.zero_amount());
+  for (const auto& job : input.jobs) {
+    has_amounts = has_amounts or input.zero_amount() << job.pickup or
+                  input.zero_amount() << job.delivery;
+    has_job_tws = has_job_tws or job.tws.size() > 1 or
+                  !job.tws.front().is_default();
+
+    // Shipment amounts are accounted for once, upon pickup.
+    jobs_amount += job.pickup;
+    if (job.type == JOB_TYPE::SINGLE) {
+      jobs_amount += job.delivery;
+    }
+  }
+
+  Amount fleet_capacity(input.zero_amount());
+  Duration horizon_start = std::numeric_limits<Duration>::max();
+  Duration horizon_end = 0;
+  for (const auto& vehicle : input.vehicles) {
+    fleet_capacity += vehicle.capacity;
+    horizon_start = std::min(horizon_start, vehicle.tw.start);
+    horizon_end = std::max(horizon_end, vehicle.tw.end);
+  }
+
+  for (std::size_t i = 0; i < amount_size; ++i) {
+    if (fleet_capacity[i] > 0) {
+      capacity_tightness =
+        std::max(capacity_tightness,
+                 static_cast<double>(jobs_amount[i]) /
+                   static_cast<double>(fleet_capacity[i]));
+    }
+  }
+
+  if (has_job_tws) {
+    if (horizon_end == std::numeric_limits<Duration>::max()) {
+      // No working hours for at least one vehicle, so use jobs time
+      // windows span instead.
+      horizon_start = std::numeric_limits<Duration>::max();
+      horizon_end = 0;
+      for (const auto& job : input.jobs) {
+        if (!job.tws.front().is_default()) {
+          horizon_start = std::min(horizon_start, job.tws.front().start);
+          horizon_end = std::max(horizon_end, job.tws.back().end);
+        }
+      }
+    }
+
+    if (horizon_start < horizon_end) {
+      const auto horizon = static_cast<double>(horizon_end - horizon_start);
+      double total_tightness = 0;
+      for (const auto& job : input.jobs) {
+        Duration available = 0;
+        for (const auto& tw : job.tws) {
+          const auto start = std::max(tw.start, horizon_start);
+          const auto end = std::min(tw.end, horizon_end);
+          if (start < end) {
+            available += end - start;
+          }
+        }
+        total_tightness += 1 - static_cast<double>(available) / horizon;
+      }
+      tw_tightness = total_tightness / static_cast<double>(input.jobs.size());
+    }
+  }
+
+  const auto nb_pairs = input.vehicles.size() * input.jobs.size();
+  if (nb_pairs > 0) {
+    std::size_t nb_compatible = 0;
+    for (Index v = 0; v < input.vehicles.size(); ++v) {
+      nb_compatible += input.compatible_jobs(v).count();
+    }
+    incompatibility = 1 - static_cast<double>(nb_compatible) /
+                            static_cast<double>(nb_pairs);
+  }
+}
+
+// Initialization strategy actually used by heuristic for given
+// parameters.
+INIT get_effective_init(const InstanceFeatures& features,
+                        const HeuristicParameters& p) {
+  if ((p.init == INIT::HIGHER_AMOUNT and !features.has_amounts) or
+      (p.init == INIT::EARLIEST_DEADLINE and !features.has_job_tws)) {
+    // No job is ever picked to start a route.
+    return INIT::NONE;
+  }
+  return p.init;
+}
+
+double get_relevance(const InstanceFeatures& features,
+                     const HeuristicParameters& p) {
+  double relevance = 0.5;
+  switch (get_effective_init(features, p)) {
+  case INIT::NONE:
+    break;
+  case INIT::HIGHER_AMOUNT:
+    relevance = features.capacity_tightness;
+    break;
+  case INIT::EARLIEST_DEADLINE:
+    relevance = features.tw_tightness;
+    break;
+  case INIT::NEAREST:
+  case INIT::FURTHEST:
+    // Spatial criteria matter most when other constraints are loose.
+    relevance =
+      1 - std::max(features.capacity_tightness, features.tw_tightness);
+    break;
+  }
+
+  if (p.heuristic == HEURISTIC::DYNAMIC) {
+    // Choosing vehicles on the fly pays off with restrictive
+    // compatibility constraints.
+    relevance += features.incompatibility;
+  }
+
+  return relevance;
+}
+
+std::vector<HeuristicParameters>
+get_portfolio(const InstanceFeatures& features,
+              const std::vector<HeuristicParameters>& parameters,
+              std::size_t nb_tuned) {
+  assert(nb_tuned <= parameters.size());
+
+  std::vector<HeuristicParameters> portfolio(parameters.begin(),
+                                             parameters.end());
+  std::stable_sort(portfolio.begin() + nb_tuned,
+                   portfolio.end(),
+                   [&](const auto& lhs, const auto& rhs) {
+                     return get_relevance(features, lhs) >
+                            get_relevance(features, rhs);
+                   });
+
+  auto is_equivalent = [&](const HeuristicParameters& lhs,
+                           const HeuristicParameters& rhs) {
+    return lhs.heuristic == rhs.heuristic and lhs.sort == rhs.sort and
+           get_effective_init(features, lhs) ==
+             get_effective_init(features, rhs) and
+           lhs.regret_coeff == rhs.regret_coeff;
+  };
+
+  std::vector<HeuristicParameters> unique_portfolio;
+  for (const auto& p : portfolio) {
+    if (std::none_of(unique_portfolio.begin(),
+                     unique_portfolio.end(),
+                     [&](const auto& other) {
+                       return is_equivalent(p, other);
+                     })) {
+      unique_portfolio.push_back(p);
+    }
+  }
+
+  return unique_portfolio;
+}
+
+std::vector<HeuristicParameters>
+get_perturbed(const std::vector<HeuristicParameters>& parameters) {
+  std::vector<HeuristicParameters> variants;
+  for (const auto& p : parameters) {
+    if (p.heuristic == HEURISTIC::BASIC or p.heuristic == HEURISTIC::DYNAMIC) {
+      auto variant = p;
+      variant.regret_coeff += REGRET_COEFF_PERTURBATION;
+      variants.push_back(variant);
+    }
+  }
+  return variants;
+}
+
+} // namespace vroom::heuristics
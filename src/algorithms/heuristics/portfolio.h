@@ -0,0 +1,49 @@
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include "structures/vroom/input/input.h"
+
+namespace vroom::heuristics {
+
+struct InstanceFeatures {
+  // Highest ratio across amount components between jobs amounts and
+  // fleet capacity.
+  double capacity_tightness{0};
+  // Average share of vehicles working hours where jobs can't be
+  // started.
+  double tw_tightness{0};
+  // Share of vehicle/job pairs that are not compatible.
+  double incompatibility{0};
+  bool has_amounts{false};
+  bool has_job_tws{false};
+
+  InstanceFeatures(const Input& input);
+};
+
+// Order heuristic parameters to try for given instance. The first
+// nb_tuned parameters are tried first in the same order, followed by
+// the other ones sorted by relevance of their initialization
+// strategy. Parameters known to result in the same solution as a
+// previous one are dropped.
+std::vector<HeuristicParameters>
+get_portfolio(const InstanceFeatures& features,
+              const std::vector<HeuristicParameters>& parameters,
+              std::size_t nb_tuned);
+
+// Variants of given parameters with a slightly different regret
+// coefficient, for heuristics using one.
+std::vector<HeuristicParameters>
+get_perturbed(const std::vector<HeuristicParameters>& parameters);
+
+} // namespace vroom::heuristics
+
+#endif
@@ -30,9 +30,13 @@ compute_best_insertion_single(const Input& input,
   const auto& v_target = input.vehicles[v];
 
   if (input.vehicle_ok_with_job(v, j)) {
-    for (Index rank = sol_state.insertion_ranks_begin[v][j];
-         rank < sol_state.insertion_ranks_end[v][j];
-         ++rank) {
+    const auto tw_ranks = route.tw_insertion_ranks(input, j);
+    const auto begin_rank =
+      std::max(sol_state.insertion_ranks_begin[v][j], tw_ranks.first);
+    const auto end_rank =
+      std::min(sol_state.insertion_ranks_end[v][j], tw_ranks.second);
+
+    for (Index rank = begin_rank; rank < end_rank; ++rank) {
       Eval current_eval =
         utils::addition_cost(input, j, v_target, route.route, rank);
       if (current_eval.cost < result.eval.cost &&
@@ -98,8 +102,11 @@ RouteInsertion compute_best_insertion_pd(const Input& input,
   std::vector<Eval> d_adds(route.size() + 1);
   std::vector<unsigned char> valid_delivery_insertions(route.size() + 1, false);
 
-  const auto begin_d_rank = sol_state.insertion_ranks_begin[v][j + 1];
-  const auto end_d_rank = sol_state.insertion_ranks_end[v][j + 1];
+  const auto d_tw_ranks = route.tw_insertion_ranks(input, j + 1);
+  const auto begin_d_rank =
+    std::max(sol_state.insertion_ranks_begin[v][j + 1], d_tw_ranks.first);
+  const auto end_d_rank =
+    std::min(sol_state.insertion_ranks_end[v][j + 1], d_tw_ranks.second);
 
   bool found_valid = false;
   for (unsigned d_rank = begin_d_rank; d_rank < end_d_rank; ++d_rank) {
@@ -119,9 +126,13 @@ RouteInsertion compute_best_insertion_pd(const Input& input,
     return result;
   }
 
-  for (Index pickup_r = sol_state.insertion_ranks_begin[v][j];
-       pickup_r < sol_state.insertion_ranks_end[v][j];
-       ++pickup_r) {
+  const auto p_tw_ranks = route.tw_insertion_ranks(input, j);
+  const auto begin_p_rank =
+    std::max(sol_state.insertion_ranks_begin[v][j], p_tw_ranks.first);
+  const auto end_p_rank =
+    std::min(sol_state.insertion_ranks_end[v][j], p_tw_ranks.second);
+
+  for (Index pickup_r = begin_p_rank; pickup_r < end_p_rank; ++pickup_r) {
     Eval p_add =
       utils::addition_cost(input, j, v_target, route.route, pickup_r);
     if (p_add > result.eval) {
@@ -208,5 +219,28 @@ RouteInsertion compute_best_insertion_pd(const Input& input,
   return result;
 }
 
+template <class Route>
+RouteInsertion compute_best_insertion(const Input& input,
+                                      const utils::SolutionState& sol_state,
+                                      const Index j,
+                                      Index v,
+                                      const Route& route) {
+  const auto& current_job = input.jobs[j];
+  assert(current_job.type == JOB_TYPE::PICKUP ||
+         current_job.type == JOB_TYPE::SINGLE);
+
+  if (current_job.type == JOB_TYPE::SINGLE) {
+    return compute_best_insertion_single(input, sol_state, j, v, route);
+  }
+  auto insert =
+    compute_best_insertion_pd(input, sol_state, j, v, route, NO_EVAL);
+  if (insert.eval != NO_EVAL) {
+    // Normalize cost per job for consistency with single jobs.
+    insert.eval.cost =
+      static_cast<Cost>(static_cast<double>(insert.eval.cost) / 2);
+  }
+  return insert;
+}
+
 } // namespace vroom::ls
 #endif
@@ -7,6 +7,11 @@ All rights reserved (see LICENSE).
 
 */
 
+#include <algorithm>
+#include <array>
+#include <map>
+#include <tuple>
+
 #include "algorithms/local_search/local_search.h"
 #include "algorithms/local_search/insertion_search.h"
 #include "problems/vrptw/operators/cross_exchange.h"
@@ -68,50 +73,104 @@ LocalSearch<Route,
             RouteSplit>::LocalSearch(const Input& input,
                                      std::vector<Route>& sol,
                                      unsigned max_nb_jobs_removal,
-                                     const Timeout& timeout)
+                                     const Timeout& timeout,
+                                     const Budget& budget,
+                                     const CancellationToken& cancellation,
+                                     const BestSolutionCallback&
+                                       best_sol_callback)
   : _input(input),
     _nb_vehicles(_input.vehicles.size()),
     _max_nb_jobs_removal(max_nb_jobs_removal),
     _deadline(timeout.has_value() ? utils::now() + timeout.value()
                                   : Deadline()),
+    _budget(budget),
+    _cancellation(cancellation),
     _all_routes(_nb_vehicles),
     _sol_state(input),
     _sol(sol),
     _best_sol(sol),
-    _best_sol_indicators(_input, _sol) {
+    _best_sol_indicators(_input, _sol),
+    _best_sol_callback(best_sol_callback),
+    _sol_versions(_nb_vehicles, 0),
+    _best_sol_versions(_nb_vehicles, 0),
+    _insertions(_nb_vehicles),
+    _insertion_versions(_nb_vehicles),
+    _local_optimum_versions(_nb_vehicles,
+                            std::numeric_limits<uint64_t>::max()),
+    _best_ops(_nb_vehicles),
+    _adaptive_operators(_input.jobs.size() >= ADAPTIVE_OPERATORS_MIN_JOBS) {
   // Initialize all route indices.
   std::iota(_all_routes.begin(), _all_routes.end(), 0);
 
   // Setup solution state.
+  const auto setup_start = stats_now();
   _sol_state.setup(_sol);
-
-#ifdef LOG_LS_OPERATORS
-  tried_moves.fill(0);
-  applied_moves.fill(0);
-#endif
+  add_elapsed_time(_state_updates_time, setup_start);
 }
 
-template <class Route>
-RouteInsertion compute_best_insertion(const Input& input,
-                                      const utils::SolutionState& sol_state,
-                                      const Index j,
-                                      Index v,
-                                      const Route& route) {
-  const auto& current_job = input.jobs[j];
-  assert(current_job.type == JOB_TYPE::PICKUP ||
-         current_job.type == JOB_TYPE::SINGLE);
-
-  if (current_job.type == JOB_TYPE::SINGLE) {
-    return compute_best_insertion_single(input, sol_state, j, v, route);
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+void LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::update_insertions(Index v) {
+  if (_sol_state.unassigned.empty()) {
+    return;
+  }
+
+  auto& insertions = _insertions[v];
+  auto& versions = _insertion_versions[v];
+  if (insertions.empty()) {
+    insertions.resize(_input.jobs.size());
+    versions.assign(_input.jobs.size(), std::numeric_limits<uint64_t>::max());
   }
-  auto insert =
-    compute_best_insertion_pd(input, sol_state, j, v, route, NO_EVAL);
-  if (insert.eval != NO_EVAL) {
-    // Normalize cost per job for consistency with single jobs.
-    insert.eval.cost =
-      static_cast<Cost>(static_cast<double>(insert.eval.cost) / 2);
+
+  const auto version = _sol_versions[v];
+  const auto fixed_cost =
+    _sol[v].empty() ? _input.vehicles[v].fixed_cost() : 0;
+
+  for (const auto j : _sol_state.unassigned) {
+    if (_input.jobs[j].type == JOB_TYPE::DELIVERY or versions[j] == version) {
+      continue;
+    }
+
+    auto& insertion = insertions[j];
+    insertion = compute_best_insertion(_input, _sol_state, j, v, _sol[v]);
+    if (insertion->eval != NO_EVAL) {
+      insertion->eval.cost += fixed_cost;
+    }
+    versions[j] = version;
   }
-  return insert;
 }
 
 template <class Route,
@@ -151,98 +210,83 @@ void LocalSearch<Route,
                  SwapStar,
                  RouteSplit>::try_job_additions(const std::vector<Index>&
                                                   routes,
-                                                double regret_coeff) {
+                                                double regret_coeff,
+                                                double noise) {
+  const auto additions_start = stats_now();
   bool job_added;
+  std::uniform_real_distribution<double> noise_factor(1 - noise, 1 + noise);
 
-  std::vector<std::vector<RouteInsertion>> route_job_insertions;
-
-  for (std::size_t i = 0; i < routes.size(); ++i) {
-    route_job_insertions.emplace_back(_input.jobs.size(),
-                                      RouteInsertion(_input.get_amount_size()));
-
-    const auto v = routes[i];
-    const auto fixed_cost =
-      _sol[v].empty() ? _input.vehicles[v].fixed_cost() : 0;
-
-    for (const auto j : _sol_state.unassigned) {
-      const auto& current_job = _input.jobs[j];
-      if (current_job.type == JOB_TYPE::DELIVERY) {
-        continue;
-      }
-      route_job_insertions[i][j] =
-        compute_best_insertion(_input, _sol_state, j, v, _sol[v]);
-
-      if (route_job_insertions[i][j].eval != NO_EVAL) {
-        route_job_insertions[i][j].eval.cost += fixed_cost;
-      }
-    }
+  // Only insertions in routes modified since last call are computed.
+  for (const auto v : routes) {
+    update_insertions(v);
   }
 
   do {
-    Priority best_priority = 0;
     RouteInsertion best_insertion(_input.get_amount_size());
     double best_cost = std::numeric_limits<double>::max();
     Index best_job_rank = 0;
     Index best_route = 0;
-    std::size_t best_route_idx = 0;
-
-    for (const auto j : _sol_state.unassigned) {
-      const auto& current_job = _input.jobs[j];
-      if (current_job.type == JOB_TYPE::DELIVERY) {
-        continue;
-      }
-
-      const auto job_priority = current_job.priority;
-
-      if (job_priority < best_priority) {
-        // Insert higher priority jobs first.
-        continue;
-      }
-
-      auto smallest = _input.get_cost_upper_bound();
-      auto second_smallest = _input.get_cost_upper_bound();
-      std::size_t smallest_idx = std::numeric_limits<std::size_t>::max();
 
-      for (std::size_t i = 0; i < routes.size(); ++i) {
-        if (route_job_insertions[i][j].eval.cost < smallest) {
-          smallest_idx = i;
-          second_smallest = smallest;
-          smallest = route_job_insertions[i][j].eval.cost;
-        } else if (route_job_insertions[i][j].eval.cost < second_smallest) {
-          second_smallest = route_job_insertions[i][j].eval.cost;
+    // Insert higher priority jobs first: unassigned jobs are bucketed
+    // by decreasing priority so lower priority buckets are only
+    // scanned if no job from a previous bucket can be added.
+    for (unsigned b = 0;
+         b < _sol_state.unassigned.nb_buckets() and
+         best_cost == std::numeric_limits<double>::max();
+         ++b) {
+      for (const auto j : _sol_state.unassigned.bucket(b)) {
+        const auto& current_job = _input.jobs[j];
+        if (current_job.type == JOB_TYPE::DELIVERY) {
+          continue;
         }
-      }
 
-      // Find best route for current job based on cost of addition and
-      // regret cost of not adding.
-      for (std::size_t i = 0; i < routes.size(); ++i) {
-        if (route_job_insertions[i][j].eval == NO_EVAL) {
-          continue;
+        auto smallest = _input.get_cost_upper_bound();
+        auto second_smallest = _input.get_cost_upper_bound();
+        std::size_t smallest_idx = std::numeric_limits<std::size_t>::max();
+
+        for (std::size_t i = 0; i < routes.size(); ++i) {
+          if (_insertions[routes[i]][j]->eval.cost < smallest) {
+            smallest_idx = i;
+            second_smallest = smallest;
+            smallest = _insertions[routes[i]][j]->eval.cost;
+          } else if (_insertions[routes[i]][j]->eval.cost < second_smallest) {
+            second_smallest = _insertions[routes[i]][j]->eval.cost;
+          }
         }
 
-        const auto& current_r = _sol[routes[i]];
-        const auto& vehicle = _input.vehicles[routes[i]];
-        bool is_pickup = (_input.jobs[j].type == JOB_TYPE::PICKUP);
+        // Find best route for current job based on cost of addition and
+        // regret cost of not adding.
+        for (std::size_t i = 0; i < routes.size(); ++i) {
+          if (_insertions[routes[i]][j]->eval == NO_EVAL) {
+            continue;
+          }
+
+          const auto& current_r = _sol[routes[i]];
+          const auto& vehicle = _input.vehicles[routes[i]];
+          bool is_pickup = (_input.jobs[j].type == JOB_TYPE::PICKUP);
 
-        if (current_r.size() + (is_pickup ? 2 : 1) > vehicle.max_tasks) {
-          continue;
-        }
+          if (current_r.size() + (is_pickup ? 2 : 1) > vehicle.max_tasks) {
+            continue;
+          }
+
+          const auto regret_cost =
+            (i == smallest_idx) ? second_smallest : smallest;
 
-        const auto regret_cost =
-          (i == smallest_idx) ? second_smallest : smallest;
+          auto insertion_cost =
+            static_cast<double>(_insertions[routes[i]][j]->eval.cost);
+          if (noise > 0) {
+            insertion_cost *= noise_factor(_rng);
+          }
 
-        const double current_cost =
-          static_cast<double>(route_job_insertions[i][j].eval.cost) -
-          regret_coeff * static_cast<double>(regret_cost);
+          const double current_cost =
+            insertion_cost - regret_coeff * static_cast<double>(regret_cost);
 
-        if ((job_priority > best_priority) or
-            (job_priority == best_priority and current_cost < best_cost)) {
-          best_priority = job_priority;
-          best_job_rank = j;
-          best_route = routes[i];
-          best_insertion = route_job_insertions[i][j];
-          best_cost = current_cost;
-          best_route_idx = i;
+          if (current_cost < best_cost) {
+            best_job_rank = j;
+            best_route = routes[i];
+            best_insertion = *_insertions[routes[i]][j];
+            best_cost = current_cost;
+          }
         }
       }
     }
@@ -250,6 +294,7 @@ void LocalSearch<Route,
     job_added = (best_cost < std::numeric_limits<double>::max());
 
     if (job_added) {
+      set_modified(best_route);
       _sol_state.unassigned.erase(best_job_rank);
       const auto& best_job = _input.jobs[best_job_rank];
 
@@ -271,8 +316,7 @@ void LocalSearch<Route,
                                  best_insertion.pickup_rank,
                                  best_insertion.delivery_rank);
 
-        assert(_sol_state.unassigned.find(best_job_rank + 1) !=
-               _sol_state.unassigned.end());
+        assert(_sol_state.unassigned.contains(best_job_rank + 1));
         _sol_state.unassigned.erase(best_job_rank + 1);
       }
 
@@ -280,27 +324,78 @@ void LocalSearch<Route,
       _sol_state.update_route_eval(_sol[best_route].route, best_route);
       _sol_state.set_insertion_ranks(_sol[best_route], best_route);
 
-      const auto fixed_cost =
-        _sol[best_route].empty() ? _input.vehicles[best_route].fixed_cost() : 0;
-
-      for (const auto j : _sol_state.unassigned) {
-        const auto& current_job = _input.jobs[j];
-        if (current_job.type == JOB_TYPE::DELIVERY) {
-          continue;
-        }
-        route_job_insertions[best_route_idx][j] =
-          compute_best_insertion(_input,
-                                 _sol_state,
-                                 j,
-                                 best_route,
-                                 _sol[best_route]);
-
-        if (route_job_insertions[best_route_idx][j].eval != NO_EVAL) {
-          route_job_insertions[best_route_idx][j].eval.cost += fixed_cost;
-        }
-      }
+      update_insertions(best_route);
     }
   } while (job_added);
+
+  add_elapsed_time(_job_additions_time, additions_start);
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+std::array<bool, OperatorName::MAX>
+LocalSearch<Route,
+            UnassignedExchange,
+            CrossExchange,
+            MixedExchange,
+            TwoOpt,
+            ReverseTwoOpt,
+            Relocate,
+            OrOpt,
+            IntraExchange,
+            IntraCrossExchange,
+            IntraMixedExchange,
+            IntraRelocate,
+            IntraOrOpt,
+            IntraTwoOpt,
+            PDShift,
+            RouteExchange,
+            SwapStar,
+            RouteSplit>::active_operators() const {
+  std::array<bool, OperatorName::MAX> active;
+  active.fill(true);
+
+  if (!_adaptive_operators) {
+    return active;
+  }
+
+  uint64_t total_applied = 0;
+  uint64_t total_tried = 0;
+  for (const auto& stats : _operator_stats) {
+    total_applied += stats.applied_moves;
+    total_tried += stats.tried_moves;
+  }
+
+  if (total_applied < ADAPTIVE_OPERATORS_WARMUP) {
+    return active;
+  }
+
+  for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+    const auto& stats = _operator_stats[op];
+    const auto applied_share = static_cast<double>(stats.applied_moves) /
+                               static_cast<double>(total_applied);
+    const auto tried_share = static_cast<double>(stats.tried_moves) /
+                             static_cast<double>(total_tried);
+    active[op] = (applied_share >= ADAPTIVE_OPERATORS_MIN_RATIO * tried_share);
+  }
+
+  return active;
 }
 
 template <class Route,
@@ -339,22 +434,32 @@ void LocalSearch<Route,
                  RouteExchange,
                  SwapStar,
                  RouteSplit>::run_ls_step() {
-  // Store best move involving a pair of routes.
-  std::vector<std::vector<std::unique_ptr<Operator>>> best_ops(_nb_vehicles);
-  for (std::size_t v = 0; v < _nb_vehicles; ++v) {
-    best_ops[v] = std::vector<std::unique_ptr<Operator>>(_nb_vehicles);
-  }
+  // Drop best moves stored for any pair of routes.
+  _best_ops.clear();
 
   // List of source/target pairs we need to test (all related vehicles
-  // at first).
+  // at first). Pairs of different routes that are unchanged since last
+  // local optimum are left out. Moves involving a single route also
+  // depend on unassigned jobs and empty routes so they are always
+  // evaluated.
   std::vector<std::pair<Index, Index>> s_t_pairs;
-  for (unsigned s_v = 0; s_v < _nb_vehicles; ++s_v) {
-    for (unsigned t_v = 0; t_v < _nb_vehicles; ++t_v) {
-      if (_input.vehicle_ok_with_vehicle(s_v, t_v)) {
-        s_t_pairs.emplace_back(s_v, t_v);
+  auto set_all_pairs = [&]() {
+    s_t_pairs.clear();
+    for (unsigned s_v = 0; s_v < _nb_vehicles; ++s_v) {
+      const bool s_unchanged =
+        (_sol_versions[s_v] == _local_optimum_versions[s_v]);
+      for (unsigned t_v = 0; t_v < _nb_vehicles; ++t_v) {
+        if (s_v != t_v and s_unchanged and
+            _sol_versions[t_v] == _local_optimum_versions[t_v]) {
+          continue;
+        }
+        if (_input.vehicle_ok_with_vehicle(s_v, t_v)) {
+          s_t_pairs.emplace_back(s_v, t_v);
+        }
       }
     }
-  }
+  };
+  set_all_pairs();
 
   // Store best gain for matching move.
   std::vector<std::vector<Eval>> best_gains(_nb_vehicles,
@@ -370,13 +475,46 @@ void LocalSearch<Route,
   Eval best_gain(static_cast<Cost>(1), static_cast<Cost>(0));
   Priority best_priority = 0;
 
+  // Operators skipped at some point since they have last been
+  // evaluated on all pairs.
+  std::array<bool, OperatorName::MAX> skipped_operators;
+  skipped_operators.fill(false);
+  bool full_sweep = false;
+
+  bool stopped = false;
+
   while (best_gain.cost > 0 or best_priority > 0) {
-    if (_deadline.has_value() and _deadline.value() < utils::now()) {
+    if (stop()) {
+      stopped = true;
       break;
     }
+    ++_nb_steps;
+
+    std::array<bool, OperatorName::MAX> active;
+    if (full_sweep) {
+      // Moves from other operators are already known for all pairs.
+      active = skipped_operators;
+      skipped_operators.fill(false);
+      full_sweep = false;
+    } else {
+      active = active_operators();
+      for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+        skipped_operators[op] = skipped_operators[op] or !active[op];
+      }
+    }
+
+    // Account for time spent since previous call in given operator.
+    auto operator_start = stats_now();
+    auto record_time = [&](OperatorName name) {
+      if (_input.get_solving_stats()) {
+        const auto now = utils::now();
+        _operator_stats[name].time += now - operator_start;
+        operator_start = now;
+      }
+    };
 
     // Operators applied to a pair of (different) routes.
-    if (_input.has_jobs()) {
+    if (_input.has_jobs() and active[OperatorName::UnassignedExchange]) {
       // Move(s) that don't make sense for shipment-only instances.
 
       // UnassignedExchange stuff
@@ -456,9 +594,7 @@ void LocalSearch<Route,
                   // Same move as with t_rank == s_rank.
                   continue;
                 }
-#ifdef LOG_LS_OPERATORS
-                ++tried_moves[OperatorName::UnassignedExchange];
-#endif
+                ++_operator_stats[OperatorName::UnassignedExchange].tried_moves;
                 UnassignedExchange r(_input,
                                      _sol_state,
                                      _sol_state.unassigned,
@@ -478,8 +614,7 @@ void LocalSearch<Route,
                   // This may potentially define a negative value as
                   // best gain in case priority_gain is non-zero.
                   best_gains[s_t.first][s_t.first] = r.gain();
-                  best_ops[s_t.first][s_t.first] =
-                    std::make_unique<UnassignedExchange>(r);
+                  _best_ops.store(s_t.first, s_t.first, std::move(r));
                 }
               }
             }
@@ -487,10 +622,12 @@ void LocalSearch<Route,
         }
       }
     }
+    record_time(OperatorName::UnassignedExchange);
 
     // CrossExchange stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.second <= s_t.first or // This operator is symmetric.
+      if (!active[OperatorName::CrossExchange] or
+          s_t.second <= s_t.first or // This operator is symmetric.
           best_priorities[s_t.first] > 0 or best_priorities[s_t.second] > 0 or
           _sol[s_t.first].size() < 2 or _sol[s_t.second].size() < 2) {
         continue;
@@ -600,9 +737,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::CrossExchange];
-#endif
+          ++_operator_stats[OperatorName::CrossExchange].tried_moves;
           CrossExchange r(_input,
                           _sol_state,
                           _sol[s_t.first],
@@ -618,17 +753,18 @@ void LocalSearch<Route,
           if (r.gain_upper_bound() > current_best and r.is_valid() and
               r.gain() > current_best) {
             current_best = r.gain();
-            best_ops[s_t.first][s_t.second] =
-              std::make_unique<CrossExchange>(r);
+            _best_ops.store(s_t.first, s_t.second, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::CrossExchange);
 
     if (_input.has_jobs()) {
       // MixedExchange stuff
       for (const auto& s_t : s_t_pairs) {
-        if (s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
+        if (!active[OperatorName::MixedExchange] or
+            s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
             best_priorities[s_t.second] > 0 or _sol[s_t.first].size() == 0 or
             _sol[s_t.second].size() < 2) {
           continue;
@@ -716,9 +852,7 @@ void LocalSearch<Route,
               continue;
             }
 
-#ifdef LOG_LS_OPERATORS
-            ++tried_moves[OperatorName::MixedExchange];
-#endif
+            ++_operator_stats[OperatorName::MixedExchange].tried_moves;
             MixedExchange r(_input,
                             _sol_state,
                             _sol[s_t.first],
@@ -733,17 +867,18 @@ void LocalSearch<Route,
             if (r.gain_upper_bound() > current_best and r.is_valid() and
                 r.gain() > current_best) {
               current_best = r.gain();
-              best_ops[s_t.first][s_t.second] =
-                std::make_unique<MixedExchange>(r);
+              _best_ops.store(s_t.first, s_t.second, std::move(r));
             }
           }
         }
       }
+      record_time(OperatorName::MixedExchange);
     }
 
     // TwoOpt stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.second <= s_t.first or // This operator is symmetric.
+      if (!active[OperatorName::TwoOpt] or
+          s_t.second <= s_t.first or // This operator is symmetric.
           best_priorities[s_t.first] > 0 or best_priorities[s_t.second] > 0) {
         continue;
       }
@@ -828,9 +963,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::TwoOpt];
-#endif
+          ++_operator_stats[OperatorName::TwoOpt].tried_moves;
           TwoOpt r(_input,
                    _sol_state,
                    _sol[s_t.first],
@@ -842,15 +975,17 @@ void LocalSearch<Route,
 
           if (r.gain() > best_gains[s_t.first][s_t.second] and r.is_valid()) {
             best_gains[s_t.first][s_t.second] = r.gain();
-            best_ops[s_t.first][s_t.second] = std::make_unique<TwoOpt>(r);
+            _best_ops.store(s_t.first, s_t.second, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::TwoOpt);
 
     // ReverseTwoOpt stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::ReverseTwoOpt] or
+          s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
           best_priorities[s_t.second] > 0) {
         continue;
       }
@@ -927,9 +1062,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::ReverseTwoOpt];
-#endif
+          ++_operator_stats[OperatorName::ReverseTwoOpt].tried_moves;
           ReverseTwoOpt r(_input,
                           _sol_state,
                           _sol[s_t.first],
@@ -941,19 +1074,20 @@ void LocalSearch<Route,
 
           if (r.gain() > best_gains[s_t.first][s_t.second] and r.is_valid()) {
             best_gains[s_t.first][s_t.second] = r.gain();
-            best_ops[s_t.first][s_t.second] =
-              std::make_unique<ReverseTwoOpt>(r);
+            _best_ops.store(s_t.first, s_t.second, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::ReverseTwoOpt);
 
     if (_input.has_jobs()) {
       // Move(s) that don't make sense for shipment-only instances.
 
       // Relocate stuff
       for (const auto& s_t : s_t_pairs) {
-        if (s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
+        if (!active[OperatorName::Relocate] or
+            s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
             best_priorities[s_t.second] > 0 or _sol[s_t.first].size() == 0) {
           continue;
         }
@@ -994,9 +1128,7 @@ void LocalSearch<Route,
                  _sol_state.insertion_ranks_begin[s_t.second][s_job_rank];
                t_rank < _sol_state.insertion_ranks_end[s_t.second][s_job_rank];
                ++t_rank) {
-#ifdef LOG_LS_OPERATORS
-            ++tried_moves[OperatorName::Relocate];
-#endif
+            ++_operator_stats[OperatorName::Relocate].tried_moves;
             Relocate r(_input,
                        _sol_state,
                        _sol[s_t.first],
@@ -1008,15 +1140,17 @@ void LocalSearch<Route,
 
             if (r.gain() > best_gains[s_t.first][s_t.second] and r.is_valid()) {
               best_gains[s_t.first][s_t.second] = r.gain();
-              best_ops[s_t.first][s_t.second] = std::make_unique<Relocate>(r);
+              _best_ops.store(s_t.first, s_t.second, std::move(r));
             }
           }
         }
       }
+      record_time(OperatorName::Relocate);
 
       // OrOpt stuff
       for (const auto& s_t : s_t_pairs) {
-        if (s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
+        if (!active[OperatorName::OrOpt] or
+            s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
             best_priorities[s_t.second] > 0 or _sol[s_t.first].size() < 2) {
           continue;
         }
@@ -1074,9 +1208,7 @@ void LocalSearch<Route,
                        .insertion_ranks_end[s_t.second][s_next_job_rank]);
           for (unsigned t_rank = insertion_start; t_rank < insertion_end;
                ++t_rank) {
-#ifdef LOG_LS_OPERATORS
-            ++tried_moves[OperatorName::OrOpt];
-#endif
+            ++_operator_stats[OperatorName::OrOpt].tried_moves;
             OrOpt r(_input,
                     _sol_state,
                     _sol[s_t.first],
@@ -1090,16 +1222,18 @@ void LocalSearch<Route,
             if (r.gain_upper_bound() > current_best and r.is_valid() and
                 r.gain() > current_best) {
               current_best = r.gain();
-              best_ops[s_t.first][s_t.second] = std::make_unique<OrOpt>(r);
+              _best_ops.store(s_t.first, s_t.second, std::move(r));
             }
           }
         }
       }
+      record_time(OperatorName::OrOpt);
     }
 
     // IntraExchange stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::IntraExchange] or
+          s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
           _sol[s_t.first].size() < 3) {
         continue;
       }
@@ -1132,9 +1266,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::IntraExchange];
-#endif
+          ++_operator_stats[OperatorName::IntraExchange].tried_moves;
           IntraExchange r(_input,
                           _sol_state,
                           _sol[s_t.first],
@@ -1144,16 +1276,18 @@ void LocalSearch<Route,
 
           if (r.gain() > best_gains[s_t.first][s_t.first] and r.is_valid()) {
             best_gains[s_t.first][s_t.first] = r.gain();
-            best_ops[s_t.first][s_t.first] = std::make_unique<IntraExchange>(r);
+            _best_ops.store(s_t.first, s_t.first, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::IntraExchange);
 
     // IntraCrossExchange stuff
     constexpr unsigned min_intra_cross_exchange_size = 5;
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::IntraCrossExchange] or
+          s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
           _sol[s_t.first].size() < min_intra_cross_exchange_size) {
         continue;
       }
@@ -1205,9 +1339,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::IntraCrossExchange];
-#endif
+          ++_operator_stats[OperatorName::IntraCrossExchange].tried_moves;
           IntraCrossExchange r(_input,
                                _sol_state,
                                _sol[s_t.first],
@@ -1221,16 +1353,17 @@ void LocalSearch<Route,
           if (r.gain_upper_bound() > current_best and r.is_valid() and
               r.gain() > current_best) {
             current_best = r.gain();
-            best_ops[s_t.first][s_t.first] =
-              std::make_unique<IntraCrossExchange>(r);
+            _best_ops.store(s_t.first, s_t.first, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::IntraCrossExchange);
 
     // IntraMixedExchange stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::IntraMixedExchange] or
+          s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
           _sol[s_t.first].size() < 4) {
         continue;
       }
@@ -1280,9 +1413,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::IntraMixedExchange];
-#endif
+          ++_operator_stats[OperatorName::IntraMixedExchange].tried_moves;
           IntraMixedExchange r(_input,
                                _sol_state,
                                _sol[s_t.first],
@@ -1294,16 +1425,17 @@ void LocalSearch<Route,
           if (r.gain_upper_bound() > current_best and r.is_valid() and
               r.gain() > current_best) {
             current_best = r.gain();
-            best_ops[s_t.first][s_t.first] =
-              std::make_unique<IntraMixedExchange>(r);
+            _best_ops.store(s_t.first, s_t.first, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::IntraMixedExchange);
 
     // IntraRelocate stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::IntraRelocate] or
+          s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
           _sol[s_t.first].size() < 2) {
         continue;
       }
@@ -1344,9 +1476,7 @@ void LocalSearch<Route,
             break;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::IntraRelocate];
-#endif
+          ++_operator_stats[OperatorName::IntraRelocate].tried_moves;
           IntraRelocate r(_input,
                           _sol_state,
                           _sol[s_t.first],
@@ -1356,15 +1486,17 @@ void LocalSearch<Route,
 
           if (r.gain() > best_gains[s_t.first][s_t.first] and r.is_valid()) {
             best_gains[s_t.first][s_t.first] = r.gain();
-            best_ops[s_t.first][s_t.first] = std::make_unique<IntraRelocate>(r);
+            _best_ops.store(s_t.first, s_t.first, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::IntraRelocate);
 
     // IntraOrOpt stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::IntraOrOpt] or
+          s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
           _sol[s_t.first].size() < 4) {
         continue;
       }
@@ -1420,9 +1552,7 @@ void LocalSearch<Route,
             break;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::IntraOrOpt];
-#endif
+          ++_operator_stats[OperatorName::IntraOrOpt].tried_moves;
           IntraOrOpt r(_input,
                        _sol_state,
                        _sol[s_t.first],
@@ -1434,15 +1564,17 @@ void LocalSearch<Route,
           if (r.gain_upper_bound() > current_best and r.is_valid() and
               r.gain() > current_best) {
             current_best = r.gain();
-            best_ops[s_t.first][s_t.first] = std::make_unique<IntraOrOpt>(r);
+            _best_ops.store(s_t.first, s_t.first, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::IntraOrOpt);
 
     // IntraTwoOpt stuff
     for (const auto& s_t : s_t_pairs) {
-      if (s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
+      if (!active[OperatorName::IntraTwoOpt] or
+          s_t.first != s_t.second or best_priorities[s_t.first] > 0 or
           _sol[s_t.first].size() < 4) {
         continue;
       }
@@ -1455,9 +1587,7 @@ void LocalSearch<Route,
                                    static_cast<Index>(end_s - 1));
 
         for (unsigned t_rank = s_rank + 2; t_rank < end_t_rank; ++t_rank) {
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::IntraTwoOpt];
-#endif
+          ++_operator_stats[OperatorName::IntraTwoOpt].tried_moves;
           IntraTwoOpt r(_input,
                         _sol_state,
                         _sol[s_t.first],
@@ -1467,18 +1597,20 @@ void LocalSearch<Route,
           auto& current_best = best_gains[s_t.first][s_t.second];
           if (r.gain() > current_best and r.is_valid()) {
             current_best = r.gain();
-            best_ops[s_t.first][s_t.first] = std::make_unique<IntraTwoOpt>(r);
+            _best_ops.store(s_t.first, s_t.first, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::IntraTwoOpt);
 
     if (_input.has_shipments()) {
       // Move(s) that don't make sense for job-only instances.
 
       // PDShift stuff
       for (const auto& s_t : s_t_pairs) {
-        if (s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
+        if (!active[OperatorName::PDShift] or
+            s_t.first == s_t.second or best_priorities[s_t.first] > 0 or
             best_priorities[s_t.second] > 0 or _sol[s_t.first].size() == 0) {
           // Don't try to put things from an empty vehicle.
           continue;
@@ -1525,9 +1657,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::PDShift];
-#endif
+          ++_operator_stats[OperatorName::PDShift].tried_moves;
           PDShift pdr(_input,
                       _sol_state,
                       _sol[s_t.first],
@@ -1541,17 +1671,19 @@ void LocalSearch<Route,
           if (pdr.gain() > best_gains[s_t.first][s_t.second] and
               pdr.is_valid()) {
             best_gains[s_t.first][s_t.second] = pdr.gain();
-            best_ops[s_t.first][s_t.second] = std::make_unique<PDShift>(pdr);
+            _best_ops.store(s_t.first, s_t.second, std::move(pdr));
           }
         }
       }
+      record_time(OperatorName::PDShift);
     }
 
     if (!_input.has_homogeneous_locations() or
         !_input.has_homogeneous_profiles() or !_input.has_homogeneous_costs()) {
       // RouteExchange stuff
       for (const auto& s_t : s_t_pairs) {
-        if (s_t.second <= s_t.first or best_priorities[s_t.first] > 0 or
+        if (!active[OperatorName::RouteExchange] or
+            s_t.second <= s_t.first or best_priorities[s_t.first] > 0 or
             best_priorities[s_t.second] > 0 or
             (_sol[s_t.first].size() == 0 and _sol[s_t.second].size() == 0) or
             _sol_state.bwd_skill_rank[s_t.first][s_t.second] > 0 or
@@ -1581,9 +1713,7 @@ void LocalSearch<Route,
           continue;
         }
 
-#ifdef LOG_LS_OPERATORS
-        ++tried_moves[OperatorName::RouteExchange];
-#endif
+        ++_operator_stats[OperatorName::RouteExchange].tried_moves;
         RouteExchange re(_input,
                          _sol_state,
                          _sol[s_t.first],
@@ -1593,24 +1723,24 @@ void LocalSearch<Route,
 
         if (re.gain() > best_gains[s_t.first][s_t.second] and re.is_valid()) {
           best_gains[s_t.first][s_t.second] = re.gain();
-          best_ops[s_t.first][s_t.second] = std::make_unique<RouteExchange>(re);
+          _best_ops.store(s_t.first, s_t.second, std::move(re));
         }
       }
+      record_time(OperatorName::RouteExchange);
     }
 
     if (_input.has_jobs()) {
       // SwapStar stuff
       for (const auto& s_t : s_t_pairs) {
-        if (s_t.second <= s_t.first or // This operator is symmetric.
+        if (!active[OperatorName::SwapStar] or
+            s_t.second <= s_t.first or // This operator is symmetric.
             best_priorities[s_t.first] > 0 or best_priorities[s_t.second] > 0 or
             _sol[s_t.first].size() == 0 or _sol[s_t.second].size() == 0 or
             !_input.vehicle_ok_with_vehicle(s_t.first, s_t.second)) {
           continue;
         }
 
-#ifdef LOG_LS_OPERATORS
-        ++tried_moves[OperatorName::SwapStar];
-#endif
+        ++_operator_stats[OperatorName::SwapStar].tried_moves;
         SwapStar r(_input,
                    _sol_state,
                    _sol[s_t.first],
@@ -1621,13 +1751,16 @@ void LocalSearch<Route,
 
         if (r.gain() > best_gains[s_t.first][s_t.second]) {
           best_gains[s_t.first][s_t.second] = r.gain();
-          best_ops[s_t.first][s_t.second] = std::make_unique<SwapStar>(r);
+          _best_ops.store(s_t.first, s_t.second, std::move(r));
         }
       }
+      record_time(OperatorName::SwapStar);
     }
 
-    if (!_input.has_homogeneous_locations() or
-        !_input.has_homogeneous_profiles() or !_input.has_homogeneous_costs()) {
+    if (active[OperatorName::RouteSplit] and
+        (!_input.has_homogeneous_locations() or
+         !_input.has_homogeneous_profiles() or
+         !_input.has_homogeneous_costs())) {
       // RouteSplit stuff
       std::vector<Index> empty_route_ranks;
       std::vector<std::reference_wrapper<Route>> empty_route_refs;
@@ -1645,9 +1778,7 @@ void LocalSearch<Route,
             continue;
           }
 
-#ifdef LOG_LS_OPERATORS
-          ++tried_moves[OperatorName::RouteSplit];
-#endif
+          ++_operator_stats[OperatorName::RouteSplit].tried_moves;
           RouteSplit r(_input,
                        _sol_state,
                        _sol[s_t.first],
@@ -1658,11 +1789,12 @@ void LocalSearch<Route,
 
           if (r.gain() > best_gains[s_t.first][s_t.second]) {
             best_gains[s_t.first][s_t.second] = r.gain();
-            best_ops[s_t.first][s_t.second] = std::make_unique<RouteSplit>(r);
+            _best_ops.store(s_t.first, s_t.second, std::move(r));
           }
         }
       }
     }
+    record_time(OperatorName::RouteSplit);
 
     // Find best overall move, first checking priority increase then
     // best gain if no priority increase is available.
@@ -1694,16 +1826,19 @@ void LocalSearch<Route,
 
     // Apply matching operator.
     if (best_priority > 0 or best_gain.cost > 0) {
-      assert(best_ops[best_source][best_target] != nullptr);
+      auto* const best_op = _best_ops.get(best_source, best_target);
+      assert(best_op != nullptr);
 
-      best_ops[best_source][best_target]->apply();
+      best_op->apply();
 
-      auto update_candidates =
-        best_ops[best_source][best_target]->update_candidates();
+      auto update_candidates = best_op->update_candidates();
+      for (auto v_rank : update_candidates) {
+        set_modified(v_rank);
+      }
 
-#ifdef LOG_LS_OPERATORS
-      ++applied_moves.at(best_ops[best_source][best_target]->get_name());
-#endif
+      auto& best_op_stats = _operator_stats[best_op->get_name()];
+      ++best_op_stats.applied_moves;
+      best_op_stats.gain += best_gain.cost;
 
 #ifndef NDEBUG
       // Update route costs.
@@ -1716,6 +1851,7 @@ void LocalSearch<Route,
                         });
 #endif
 
+      auto updates_start = stats_now();
       for (auto v_rank : update_candidates) {
         _sol_state.update_route_eval(_sol[v_rank].route, v_rank);
 
@@ -1740,11 +1876,11 @@ void LocalSearch<Route,
         // actually required for consistency inside try_job_additions.
         _sol_state.set_insertion_ranks(_sol[v_rank], v_rank);
       }
+      add_elapsed_time(_state_updates_time, updates_start);
 
-      try_job_additions(best_ops[best_source][best_target]
-                          ->addition_candidates(),
-                        0);
+      try_job_additions(best_op->addition_candidates(), 0);
 
+      updates_start = stats_now();
       for (auto v_rank : update_candidates) {
         _sol_state.update_costs(_sol[v_rank].route, v_rank);
         _sol_state.update_skills(_sol[v_rank].route, v_rank);
@@ -1753,6 +1889,7 @@ void LocalSearch<Route,
         _sol_state.set_pd_matching_ranks(_sol[v_rank].route, v_rank);
         _sol_state.set_pd_gains(_sol[v_rank].route, v_rank);
       }
+      add_elapsed_time(_state_updates_time, updates_start);
 
       // Set gains to zero for what needs to be recomputed in the next
       // round and set route pairs accordingly.
@@ -1760,14 +1897,16 @@ void LocalSearch<Route,
       for (auto v_rank : update_candidates) {
         best_gains[v_rank].assign(_nb_vehicles, Eval());
         best_priorities[v_rank] = 0;
-        best_ops[v_rank] = std::vector<std::unique_ptr<Operator>>(_nb_vehicles);
+        for (unsigned v = 0; v < _nb_vehicles; ++v) {
+          _best_ops.clear(v_rank, v);
+        }
       }
 
       for (unsigned v = 0; v < _nb_vehicles; ++v) {
         for (auto v_rank : update_candidates) {
           if (_input.vehicle_ok_with_vehicle(v, v_rank)) {
             best_gains[v][v_rank] = Eval();
-            best_ops[v][v_rank] = std::unique_ptr<Operator>();
+            _best_ops.clear(v, v_rank);
 
             s_t_pairs.emplace_back(v, v_rank);
             if (v != v_rank) {
@@ -1778,15 +1917,15 @@ void LocalSearch<Route,
       }
 
       for (unsigned v = 0; v < _nb_vehicles; ++v) {
-        if (best_ops[v][v] == nullptr) {
+        const auto* const op = _best_ops.get(v, v);
+        if (op == nullptr) {
           continue;
         }
 
         bool invalidate_move = false;
 
-        for (auto req_u : best_ops[v][v]->required_unassigned()) {
-          if (_sol_state.unassigned.find(req_u) ==
-              _sol_state.unassigned.end()) {
+        for (auto req_u : op->required_unassigned()) {
+          if (!_sol_state.unassigned.contains(req_u)) {
             // This move should be invalidated because a required
             // unassigned job has been added by try_job_additions in
             // the meantime.
@@ -1796,19 +1935,30 @@ void LocalSearch<Route,
         }
 
         for (auto v_rank : update_candidates) {
-          invalidate_move =
-            invalidate_move or best_ops[v][v]->invalidated_by(v_rank);
+          invalidate_move = invalidate_move or op->invalidated_by(v_rank);
         }
 
         if (invalidate_move) {
           best_gains[v][v] = Eval();
           best_priorities[v] = 0;
-          best_ops[v][v] = std::unique_ptr<Operator>();
+          _best_ops.clear(v, v);
           s_t_pairs.emplace_back(v, v);
         }
       }
+    } else if (std::find(skipped_operators.begin(),
+                         skipped_operators.end(),
+                         true) != skipped_operators.end()) {
+      // Skipped operators may provide an improving move, so evaluate
+      // them on all pairs before stopping.
+      full_sweep = true;
+      set_all_pairs();
+      best_gain = Eval(static_cast<Cost>(1), static_cast<Cost>(0));
     }
   }
+
+  if (!stopped) {
+    _local_optimum_versions = _sol_versions;
+  }
 }
 
 template <class Route,
@@ -1846,78 +1996,17 @@ void LocalSearch<Route,
                  PDShift,
                  RouteExchange,
                  SwapStar,
-                 RouteSplit>::run() {
-  bool try_ls_step = true;
-  bool first_step = true;
-
-  unsigned current_nb_removal = 1;
-
-  while (try_ls_step) {
-    // A round of local search.
-    run_ls_step();
-
-    // Indicators for current solution.
-    utils::SolutionIndicators<Route> current_sol_indicators(_input, _sol);
-
-    if (current_sol_indicators < _best_sol_indicators) {
-      _best_sol_indicators = current_sol_indicators;
-      _best_sol = _sol;
-    } else {
-      if (!first_step) {
-        ++current_nb_removal;
-      }
-      if (_best_sol_indicators < current_sol_indicators) {
-        // Back to best known solution for further steps.
-        _sol = _best_sol;
-        _sol_state.setup(_sol);
-      }
-    }
-
-    // Try again on each improvement until we reach last job removal
-    // level or deadline is met.
-    try_ls_step = (current_nb_removal <= _max_nb_jobs_removal) and
-                  (!_deadline.has_value() or utils::now() < _deadline.value());
-
-    if (try_ls_step) {
-      // Get a looser situation by removing jobs.
-      for (unsigned i = 0; i < current_nb_removal; ++i) {
-        remove_from_routes();
-        for (std::size_t v = 0; v < _sol.size(); ++v) {
-          // Update what is required for consistency in
-          // remove_from_route.
-          _sol_state.update_route_eval(_sol[v].route, v);
-          _sol_state.set_node_gains(_sol[v].route, v);
-          _sol_state.set_pd_matching_ranks(_sol[v].route, v);
-          _sol_state.set_pd_gains(_sol[v].route, v);
-        }
-      }
-
-      // Update insertion ranks ranges.
-      for (std::size_t v = 0; v < _sol.size(); ++v) {
-        _sol_state.set_insertion_ranks(_sol[v], v);
-      }
-
-      // Refill jobs.
-      constexpr double refill_regret = 1.5;
-      try_job_additions(_all_routes, refill_regret);
-
-      // Update everything except what has already been updated in
-      // try_job_additions.
-      for (std::size_t v = 0; v < _sol.size(); ++v) {
-        _sol_state.update_costs(_sol[v].route, v);
-        _sol_state.update_skills(_sol[v].route, v);
-        _sol_state.set_node_gains(_sol[v].route, v);
-        _sol_state.set_edge_gains(_sol[v].route, v);
-        _sol_state.set_pd_matching_ranks(_sol[v].route, v);
-        _sol_state.set_pd_gains(_sol[v].route, v);
-      }
+                 RouteSplit>::
+  save_routes(std::vector<Route>& snapshot,
+              std::vector<uint64_t>& snapshot_versions) const {
+  for (std::size_t v = 0; v < _sol.size(); ++v) {
+    if (snapshot_versions[v] != _sol_versions[v]) {
+      snapshot[v] = _sol[v];
+      snapshot_versions[v] = _sol_versions[v];
     }
-
-    first_step = false;
   }
 }
 
-#ifdef LOG_LS_OPERATORS
 template <class Route,
           class UnassignedExchange,
           class CrossExchange,
@@ -1936,33 +2025,55 @@ template <class Route,
           class RouteExchange,
           class SwapStar,
           class RouteSplit>
-std::array<OperatorStats, OperatorName::MAX>
-LocalSearch<Route,
-            UnassignedExchange,
-            CrossExchange,
-            MixedExchange,
-            TwoOpt,
-            ReverseTwoOpt,
-            Relocate,
-            OrOpt,
-            IntraExchange,
-            IntraCrossExchange,
-            IntraMixedExchange,
-            IntraRelocate,
-            IntraOrOpt,
-            IntraTwoOpt,
-            PDShift,
-            RouteExchange,
-            SwapStar,
-            RouteSplit>::get_stats() const {
-  std::array<OperatorStats, OperatorName::MAX> stats;
-  for (auto op = 0; op < OperatorName::MAX; ++op) {
-    stats[op] = OperatorStats(tried_moves.at(op), applied_moves.at(op));
-  }
-
-  return stats;
+void LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::
+  restore_routes(const std::vector<Route>& snapshot,
+                 const std::vector<uint64_t>& snapshot_versions) {
+  const auto updates_start = stats_now();
+
+  std::vector<Index> restored;
+  for (Index v = 0; v < _sol.size(); ++v) {
+    if (_sol_versions[v] != snapshot_versions[v]) {
+      restored.push_back(v);
+    }
+  }
+
+  // Other routes are the same in both solutions, so jobs switching
+  // between assigned and unassigned all belong to restored routes.
+  for (const auto v : restored) {
+    for (const auto j : _sol[v].route) {
+      _sol_state.unassigned.insert(j);
+    }
+  }
+
+  for (const auto v : restored) {
+    _sol[v] = snapshot[v];
+    _sol_versions[v] = snapshot_versions[v];
+
+    for (const auto j : _sol[v].route) {
+      _sol_state.unassigned.erase(j);
+    }
+    _sol_state.setup(_sol[v], v);
+  }
+
+  add_elapsed_time(_state_updates_time, updates_start);
 }
-#endif
 
 template <class Route,
           class UnassignedExchange,
@@ -1982,7 +2093,7 @@ template <class Route,
           class RouteExchange,
           class SwapStar,
           class RouteSplit>
-Eval LocalSearch<Route,
+void LocalSearch<Route,
                  UnassignedExchange,
                  CrossExchange,
                  MixedExchange,
@@ -1999,40 +2110,14 @@ Eval LocalSearch<Route,
                  PDShift,
                  RouteExchange,
                  SwapStar,
-                 RouteSplit>::job_route_cost(Index v_target, Index v, Index r) {
-  assert(v != v_target);
+                 RouteSplit>::
+  set_best_sol(const utils::SolutionIndicators<Route>& indicators) {
+  _best_sol_indicators = indicators;
+  save_routes(_best_sol, _best_sol_versions);
 
-  Eval eval = NO_EVAL;
-  const auto job_index = _input.jobs[_sol[v].route[r]].index();
-
-  const auto& vehicle = _input.vehicles[v_target];
-  if (vehicle.has_start()) {
-    const auto start_index = vehicle.start.value().index();
-    const auto start_eval = vehicle.eval(start_index, job_index);
-    eval = std::min(eval, start_eval);
-  }
-  if (vehicle.has_end()) {
-    const auto end_index = vehicle.end.value().index();
-    const auto end_eval = vehicle.eval(job_index, end_index);
-    eval = std::min(eval, end_eval);
-  }
-  if (_sol[v_target].size() != 0) {
-    const auto cheapest_from_rank =
-      _sol_state.cheapest_job_rank_in_routes_from[v][v_target][r];
-    const auto cheapest_from_index =
-      _input.jobs[_sol[v_target].route[cheapest_from_rank]].index();
-    const auto eval_from = vehicle.eval(cheapest_from_index, job_index);
-    eval = std::min(eval, eval_from);
-
-    const auto cheapest_to_rank =
-      _sol_state.cheapest_job_rank_in_routes_to[v][v_target][r];
-    const auto cheapest_to_index =
-      _input.jobs[_sol[v_target].route[cheapest_to_rank]].index();
-    const auto eval_to = vehicle.eval(job_index, cheapest_to_index);
-    eval = std::min(eval, eval_to);
+  if (_best_sol_callback) {
+    _best_sol_callback(_best_sol, _best_sol_indicators);
   }
-
-  return eval;
 }
 
 template <class Route,
@@ -2053,7 +2138,7 @@ template <class Route,
           class RouteExchange,
           class SwapStar,
           class RouteSplit>
-Eval LocalSearch<Route,
+void LocalSearch<Route,
                  UnassignedExchange,
                  CrossExchange,
                  MixedExchange,
@@ -2070,19 +2155,30 @@ Eval LocalSearch<Route,
                  PDShift,
                  RouteExchange,
                  SwapStar,
-                 RouteSplit>::relocate_cost_lower_bound(Index v, Index r) {
-  Eval best_bound = NO_EVAL;
+                 RouteSplit>::insert_unassigned() {
+  if (_sol_state.unassigned.empty()) {
+    return;
+  }
 
-  for (std::size_t other_v = 0; other_v < _sol.size(); ++other_v) {
-    if (other_v == v or
-        !_input.vehicle_ok_with_job(other_v, _sol[v].route[r])) {
-      continue;
-    }
+  try_job_additions(_all_routes, 0);
 
-    best_bound = std::min(best_bound, job_route_cost(other_v, v, r));
+  // Update everything except what has already been updated in
+  // try_job_additions.
+  const auto updates_start = stats_now();
+  for (std::size_t v = 0; v < _sol.size(); ++v) {
+    _sol_state.update_costs(_sol[v].route, v);
+    _sol_state.update_skills(_sol[v].route, v);
+    _sol_state.set_node_gains(_sol[v].route, v);
+    _sol_state.set_edge_gains(_sol[v].route, v);
+    _sol_state.set_pd_matching_ranks(_sol[v].route, v);
+    _sol_state.set_pd_gains(_sol[v].route, v);
   }
+  add_elapsed_time(_state_updates_time, updates_start);
 
-  return best_bound;
+  utils::SolutionIndicators<Route> current_sol_indicators(_input, _sol);
+  if (current_sol_indicators < _best_sol_indicators) {
+    set_best_sol(current_sol_indicators);
+  }
 }
 
 template <class Route,
@@ -2103,7 +2199,7 @@ template <class Route,
           class RouteExchange,
           class SwapStar,
           class RouteSplit>
-Eval LocalSearch<Route,
+void LocalSearch<Route,
                  UnassignedExchange,
                  CrossExchange,
                  MixedExchange,
@@ -2120,23 +2216,79 @@ Eval LocalSearch<Route,
                  PDShift,
                  RouteExchange,
                  SwapStar,
-                 RouteSplit>::relocate_cost_lower_bound(Index v,
-                                                        Index r1,
-                                                        Index r2) {
-  Eval best_bound = NO_EVAL;
+                 RouteSplit>::descend() {
+  bool try_ls_step = true;
+  bool first_step = true;
 
-  for (std::size_t other_v = 0; other_v < _sol.size(); ++other_v) {
-    if (other_v == v or
-        !_input.vehicle_ok_with_job(other_v, _sol[v].route[r1])) {
-      continue;
+  unsigned current_nb_removal = 1;
+
+  while (try_ls_step) {
+    // A round of local search.
+    run_ls_step();
+
+    // Indicators for current solution.
+    utils::SolutionIndicators<Route> current_sol_indicators(_input, _sol);
+
+    if (current_sol_indicators < _best_sol_indicators) {
+      set_best_sol(current_sol_indicators);
+    } else {
+      if (!first_step) {
+        ++current_nb_removal;
+      }
+      if (_best_sol_indicators < current_sol_indicators) {
+        // Back to best known solution for further steps.
+        restore_routes(_best_sol, _best_sol_versions);
+      }
     }
 
-    best_bound =
-      std::min(best_bound,
-               job_route_cost(other_v, v, r1) + job_route_cost(other_v, v, r2));
-  }
+    // Try again on each improvement until we reach last job removal
+    // level or search has to stop.
+    try_ls_step = (current_nb_removal <= _max_nb_jobs_removal) and !stop();
 
-  return best_bound;
+    if (try_ls_step) {
+      // Get a looser situation by removing jobs.
+      for (unsigned i = 0; i < current_nb_removal; ++i) {
+        remove_from_routes();
+
+        const auto updates_start = stats_now();
+        for (std::size_t v = 0; v < _sol.size(); ++v) {
+          // Update what is required for consistency in
+          // remove_from_route.
+          _sol_state.update_route_eval(_sol[v].route, v);
+          _sol_state.set_node_gains(_sol[v].route, v);
+          _sol_state.set_pd_matching_ranks(_sol[v].route, v);
+          _sol_state.set_pd_gains(_sol[v].route, v);
+        }
+        add_elapsed_time(_state_updates_time, updates_start);
+      }
+
+      // Update insertion ranks ranges.
+      const auto ranks_start = stats_now();
+      for (std::size_t v = 0; v < _sol.size(); ++v) {
+        _sol_state.set_insertion_ranks(_sol[v], v);
+      }
+      add_elapsed_time(_state_updates_time, ranks_start);
+
+      // Refill jobs.
+      constexpr double refill_regret = 1.5;
+      try_job_additions(_all_routes, refill_regret);
+
+      // Update everything except what has already been updated in
+      // try_job_additions.
+      const auto updates_start = stats_now();
+      for (std::size_t v = 0; v < _sol.size(); ++v) {
+        _sol_state.update_costs(_sol[v].route, v);
+        _sol_state.update_skills(_sol[v].route, v);
+        _sol_state.set_node_gains(_sol[v].route, v);
+        _sol_state.set_edge_gains(_sol[v].route, v);
+        _sol_state.set_pd_matching_ranks(_sol[v].route, v);
+        _sol_state.set_pd_gains(_sol[v].route, v);
+      }
+      add_elapsed_time(_state_updates_time, updates_start);
+    }
+
+    first_step = false;
+  }
 }
 
 template <class Route,
@@ -2174,38 +2326,301 @@ void LocalSearch<Route,
                  PDShift,
                  RouteExchange,
                  SwapStar,
-                 RouteSplit>::remove_from_routes() {
-  // Store nearest job from and to any job in any route for constant
-  // time access down the line.
-  for (std::size_t v1 = 0; v1 < _nb_vehicles; ++v1) {
-    for (std::size_t v2 = 0; v2 < _nb_vehicles; ++v2) {
-      if (v2 == v1) {
-        continue;
-      }
-      _sol_state.update_cheapest_job_rank_in_routes(_sol[v1].route,
-                                                    _sol[v2].route,
-                                                    v1,
-                                                    v2);
+                 RouteSplit>::run() {
+  descend();
+
+  if (_deadline.has_value() or _budget.has_value()) {
+    // Use remaining time or steps to escape current local optimum.
+    if (_input.get_guided_local_search()) {
+      guided_local_search();
+    } else {
+      ruin_and_recreate();
     }
   }
+}
 
-  // Remove best node candidate from all routes.
-  std::vector<std::pair<Index, Index>> routes_and_ranks;
-
-  for (std::size_t v = 0; v < _sol.size(); ++v) {
-    if (_sol[v].empty()) {
-      continue;
-    }
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+std::array<OperatorStats, OperatorName::MAX>
+LocalSearch<Route,
+            UnassignedExchange,
+            CrossExchange,
+            MixedExchange,
+            TwoOpt,
+            ReverseTwoOpt,
+            Relocate,
+            OrOpt,
+            IntraExchange,
+            IntraCrossExchange,
+            IntraMixedExchange,
+            IntraRelocate,
+            IntraOrOpt,
+            IntraTwoOpt,
+            PDShift,
+            RouteExchange,
+            SwapStar,
+            RouteSplit>::get_stats() const {
+  return _operator_stats;
+}
 
-    // Try removing the best node (good gain on current route and
-    // small cost to closest node in another compatible route).
-    Index best_rank = 0;
-    Eval best_gain = NO_GAIN;
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+Eval LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::job_route_cost(Index v_target, Index v, Index r) {
+  assert(v != v_target);
 
-    const auto current_travel_time = _sol_state.route_evals[v].duration;
+  Eval eval = NO_EVAL;
+  const auto job_index = _input.jobs[_sol[v].route[r]].index();
 
-    for (std::size_t r = 0; r < _sol[v].size(); ++r) {
-      const auto& current_job = _input.jobs[_sol[v].route[r]];
+  const auto& vehicle = _input.vehicles[v_target];
+  if (vehicle.has_start()) {
+    const auto start_index = vehicle.start.value().index();
+    const auto start_eval = vehicle.eval(start_index, job_index);
+    eval = std::min(eval, start_eval);
+  }
+  if (vehicle.has_end()) {
+    const auto end_index = vehicle.end.value().index();
+    const auto end_eval = vehicle.eval(job_index, end_index);
+    eval = std::min(eval, end_eval);
+  }
+  if (_sol[v_target].size() != 0) {
+    const auto cheapest_from_rank =
+      _sol_state.cheapest_job_rank_in_routes_from[v][v_target][r];
+    const auto cheapest_from_index =
+      _input.jobs[_sol[v_target].route[cheapest_from_rank]].index();
+    const auto eval_from = vehicle.eval(cheapest_from_index, job_index);
+    eval = std::min(eval, eval_from);
+
+    const auto cheapest_to_rank =
+      _sol_state.cheapest_job_rank_in_routes_to[v][v_target][r];
+    const auto cheapest_to_index =
+      _input.jobs[_sol[v_target].route[cheapest_to_rank]].index();
+    const auto eval_to = vehicle.eval(job_index, cheapest_to_index);
+    eval = std::min(eval, eval_to);
+  }
+
+  return eval;
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+Eval LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::relocate_cost_lower_bound(Index v, Index r) {
+  Eval best_bound = NO_EVAL;
+
+  for (std::size_t other_v = 0; other_v < _sol.size(); ++other_v) {
+    if (other_v == v or
+        !_input.vehicle_ok_with_job(other_v, _sol[v].route[r])) {
+      continue;
+    }
+
+    best_bound = std::min(best_bound, job_route_cost(other_v, v, r));
+  }
+
+  return best_bound;
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+Eval LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::relocate_cost_lower_bound(Index v,
+                                                        Index r1,
+                                                        Index r2) {
+  Eval best_bound = NO_EVAL;
+
+  for (std::size_t other_v = 0; other_v < _sol.size(); ++other_v) {
+    if (other_v == v or
+        !_input.vehicle_ok_with_job(other_v, _sol[v].route[r1])) {
+      continue;
+    }
+
+    best_bound =
+      std::min(best_bound,
+               job_route_cost(other_v, v, r1) + job_route_cost(other_v, v, r2));
+  }
+
+  return best_bound;
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+void LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::remove_from_routes() {
+  // Store nearest job from and to any job in any route for constant
+  // time access down the line.
+  for (std::size_t v1 = 0; v1 < _nb_vehicles; ++v1) {
+    for (std::size_t v2 = 0; v2 < _nb_vehicles; ++v2) {
+      if (v2 == v1) {
+        continue;
+      }
+      _sol_state.update_cheapest_job_rank_in_routes(_sol[v1].route,
+                                                    _sol[v2].route,
+                                                    v1,
+                                                    v2);
+    }
+  }
+
+  // Remove best node candidate from all routes.
+  std::vector<std::pair<Index, Index>> routes_and_ranks;
+
+  for (std::size_t v = 0; v < _sol.size(); ++v) {
+    if (_sol[v].empty()) {
+      continue;
+    }
+
+    // Try removing the best node (good gain on current route and
+    // small cost to closest node in another compatible route).
+    Index best_rank = 0;
+    Eval best_gain = NO_GAIN;
+
+    const auto current_travel_time = _sol_state.route_evals[v].duration;
+
+    for (std::size_t r = 0; r < _sol[v].size(); ++r) {
+      const auto& current_job = _input.jobs[_sol[v].route[r]];
       if (current_job.type == JOB_TYPE::DELIVERY) {
         continue;
       }
@@ -2266,6 +2681,7 @@ void LocalSearch<Route,
     const auto v = r_r.first;
     const auto r = r_r.second;
 
+    set_modified(v);
     _sol_state.unassigned.insert(_sol[v].route[r]);
 
     const auto& current_job = _input.jobs[_sol[v].route[r]];
@@ -2300,6 +2716,623 @@ void LocalSearch<Route,
   }
 }
 
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+utils::Bitset LocalSearch<Route,
+                          UnassignedExchange,
+                          CrossExchange,
+                          MixedExchange,
+                          TwoOpt,
+                          ReverseTwoOpt,
+                          Relocate,
+                          OrOpt,
+                          IntraExchange,
+                          IntraCrossExchange,
+                          IntraMixedExchange,
+                          IntraRelocate,
+                          IntraOrOpt,
+                          IntraTwoOpt,
+                          PDShift,
+                          RouteExchange,
+                          SwapStar,
+                          RouteSplit>::select_ruined_jobs(RUIN ruin,
+                                                      unsigned nb_jobs) {
+  utils::Bitset ruined(_input.jobs.size());
+  unsigned nb_ruined = 0;
+
+  // Mark job for removal, along with matching pickup or delivery.
+  auto add_job = [&](Index j) {
+    if (ruined.test(j)) {
+      return;
+    }
+    ruined.set(j);
+    ++nb_ruined;
+
+    const auto job_type = _input.jobs[j].type;
+    if (job_type != JOB_TYPE::SINGLE) {
+      ruined.set((job_type == JOB_TYPE::PICKUP) ? j + 1 : j - 1);
+      ++nb_ruined;
+    }
+  };
+
+  // Assigned jobs along with their route, shipments being represented
+  // by their pickup.
+  std::vector<Index> candidates;
+  std::vector<Index> job_routes(_input.jobs.size());
+  for (Index v = 0; v < _sol.size(); ++v) {
+    for (const auto j : _sol[v].route) {
+      job_routes[j] = v;
+      if (_input.jobs[j].type != JOB_TYPE::DELIVERY) {
+        candidates.push_back(j);
+      }
+    }
+  }
+
+  if (candidates.empty()) {
+    return ruined;
+  }
+
+  if (ruin == RUIN::ROUTE) {
+    // Remove whole routes in random order.
+    std::vector<Index> routes;
+    for (Index v = 0; v < _sol.size(); ++v) {
+      if (!_sol[v].empty()) {
+        routes.push_back(v);
+      }
+    }
+    std::shuffle(routes.begin(), routes.end(), _rng);
+
+    for (const auto v : routes) {
+      if (nb_ruined >= nb_jobs) {
+        break;
+      }
+      for (const auto j : _sol[v].route) {
+        add_job(j);
+      }
+    }
+
+    return ruined;
+  }
+
+  if (ruin == RUIN::RANDOM) {
+    std::shuffle(candidates.begin(), candidates.end(), _rng);
+  } else {
+    // Sort candidates by relatedness to a random seed job. Cost
+    // matrix is not symmetric so cost is accounted for both ways.
+    const auto seed = candidates[std::uniform_int_distribution<
+      std::size_t>(0, candidates.size() - 1)(_rng)];
+    const auto& seed_job = _input.jobs[seed];
+    const auto& vehicle = _input.vehicles[job_routes[seed]];
+
+    std::vector<std::tuple<Duration, Cost, Index>> related;
+    related.reserve(candidates.size());
+    for (const auto j : candidates) {
+      const auto& job = _input.jobs[j];
+
+      Duration tw_gap = 0;
+      if (ruin == RUIN::TIME_WINDOW) {
+        tw_gap = std::max(seed_job.tws.front().start, job.tws.front().start) -
+                 std::min(seed_job.tws.front().start, job.tws.front().start) +
+                 std::max(seed_job.tws.back().end, job.tws.back().end) -
+                 std::min(seed_job.tws.back().end, job.tws.back().end);
+      }
+
+      related.emplace_back(tw_gap,
+                           vehicle.cost(seed_job.index(), job.index()) +
+                             vehicle.cost(job.index(), seed_job.index()),
+                           j);
+    }
+    std::sort(related.begin(), related.end());
+
+    for (std::size_t i = 0; i < related.size(); ++i) {
+      candidates[i] = std::get<2>(related[i]);
+    }
+  }
+
+  if (ruin == RUIN::STRING) {
+    // Remove a string of consecutive jobs around each candidate, at
+    // most one string per route.
+    utils::Bitset ruined_routes(_nb_vehicles);
+    const unsigned max_string_length = std::max(1u, nb_jobs / 2);
+
+    for (const auto j : candidates) {
+      if (nb_ruined >= nb_jobs) {
+        break;
+      }
+      const auto v = job_routes[j];
+      if (ruined_routes.test(v)) {
+        continue;
+      }
+      ruined_routes.set(v);
+
+      const auto& route = _sol[v].route;
+      const std::size_t rank =
+        std::distance(route.begin(), std::find(route.begin(), route.end(), j));
+      const std::size_t length = std::uniform_int_distribution<std::size_t>(
+        1,
+        std::min<std::size_t>(max_string_length, route.size()))(_rng);
+      const std::size_t first_rank = std::uniform_int_distribution<
+        std::size_t>((rank + 1 < length) ? 0 : rank + 1 - length,
+                     std::min(rank, route.size() - length))(_rng);
+
+      for (std::size_t r = first_rank; r < first_rank + length; ++r) {
+        add_job(route[r]);
+      }
+    }
+  } else {
+    for (const auto j : candidates) {
+      if (nb_ruined >= nb_jobs) {
+        break;
+      }
+      add_job(j);
+    }
+  }
+
+  return ruined;
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+void LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::remove_jobs(const utils::Bitset& ruined) {
+  for (Index v = 0; v < _sol.size(); ++v) {
+    const auto& route = _sol[v].route;
+    const auto route_size = route.size();
+
+    std::vector<Index> kept;
+    Amount delivery = _input.zero_amount();
+    for (const auto j : route) {
+      if (!ruined.test(j)) {
+        kept.push_back(j);
+        if (_input.jobs[j].type == JOB_TYPE::SINGLE) {
+          delivery += _input.jobs[j].delivery;
+        }
+      }
+    }
+
+    if (kept.size() == route_size) {
+      continue;
+    }
+
+    // Removing jobs can lead to an invalid route (see #172), or
+    // increase travel time without triangular inequality.
+    const auto kept_eval = utils::route_eval_for_vehicle(_input, v, kept);
+    if (!_input.vehicles[v].ok_for_travel_time(kept_eval.duration) or
+        !_sol[v].is_valid_addition_for_tw(_input,
+                                          delivery,
+                                          kept.begin(),
+                                          kept.end(),
+                                          0,
+                                          route_size)) {
+      continue;
+    }
+
+    for (const auto j : route) {
+      if (ruined.test(j)) {
+        _sol_state.unassigned.insert(j);
+      }
+    }
+
+    set_modified(v);
+    _sol[v].replace(_input,
+                    delivery,
+                    kept.begin(),
+                    kept.end(),
+                    0,
+                    route_size);
+  }
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+void LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::ruin_and_recreate() {
+  const auto start = utils::now();
+  const auto start_steps = _nb_steps;
+
+  // Share of remaining time or budget already used in this phase.
+  auto progress = [&]() {
+    double used = 0;
+    if (_deadline.has_value() and start < _deadline.value()) {
+      used = static_cast<double>((utils::now() - start).count()) /
+             static_cast<double>((_deadline.value() - start).count());
+    }
+    if (_budget.has_value() and start_steps < _budget.value()) {
+      used = std::max(used,
+                      static_cast<double>(_nb_steps - start_steps) /
+                        static_cast<double>(_budget.value() - start_steps));
+    }
+    return std::min(used, 1.0);
+  };
+
+  constexpr std::array<RUIN, 5> ruins = {RUIN::RANDOM,
+                                         RUIN::STRING,
+                                         RUIN::DISTANCE,
+                                         RUIN::TIME_WINDOW,
+                                         RUIN::ROUTE};
+  std::uniform_int_distribution<std::size_t> ruin_choice(0, ruins.size() - 1);
+
+  // Solution the next ruin step starts from.
+  std::vector<Route> accepted_sol = _sol;
+  std::vector<uint64_t> accepted_versions = _sol_versions;
+
+  while (!stop() and _best_sol_indicators.assigned > 0) {
+    const unsigned max_ruin_size =
+      std::clamp(static_cast<unsigned>(MAX_RUIN_SHARE *
+                                       _best_sol_indicators.assigned),
+                 1u,
+                 MAX_RUIN_SIZE);
+    const auto nb_jobs =
+      std::uniform_int_distribution<unsigned>(1, max_ruin_size)(_rng);
+
+    remove_jobs(select_ruined_jobs(ruins[ruin_choice(_rng)], nb_jobs));
+
+    auto updates_start = stats_now();
+    for (std::size_t v = 0; v < _sol.size(); ++v) {
+      // Update what is required for consistency in try_job_additions.
+      _sol_state.update_route_eval(_sol[v].route, v);
+      _sol_state.set_node_gains(_sol[v].route, v);
+      _sol_state.set_pd_matching_ranks(_sol[v].route, v);
+      _sol_state.set_pd_gains(_sol[v].route, v);
+      _sol_state.set_insertion_ranks(_sol[v], v);
+    }
+    add_elapsed_time(_state_updates_time, updates_start);
+
+    // Refill jobs with noisy insertion costs.
+    constexpr double refill_regret = 1.5;
+    try_job_additions(_all_routes, refill_regret, RECREATE_NOISE);
+
+    // Update everything except what has already been updated in
+    // try_job_additions.
+    updates_start = stats_now();
+    for (std::size_t v = 0; v < _sol.size(); ++v) {
+      _sol_state.update_costs(_sol[v].route, v);
+      _sol_state.update_skills(_sol[v].route, v);
+      _sol_state.set_node_gains(_sol[v].route, v);
+      _sol_state.set_edge_gains(_sol[v].route, v);
+      _sol_state.set_pd_matching_ranks(_sol[v].route, v);
+      _sol_state.set_pd_gains(_sol[v].route, v);
+    }
+    add_elapsed_time(_state_updates_time, updates_start);
+
+    run_ls_step();
+
+    utils::SolutionIndicators<Route> current_sol_indicators(_input, _sol);
+
+    if (current_sol_indicators < _best_sol_indicators) {
+      set_best_sol(current_sol_indicators);
+      save_routes(accepted_sol, accepted_versions);
+      continue;
+    }
+
+    // Record-to-record acceptance for solutions with the same
+    // assigned jobs as best known solution.
+    const auto best_cost =
+      static_cast<double>(_best_sol_indicators.eval.cost);
+    const auto threshold =
+      RECORD_TO_RECORD_THRESHOLD * (1 - progress()) * best_cost;
+
+    if (current_sol_indicators.priority_sum ==
+          _best_sol_indicators.priority_sum and
+        current_sol_indicators.assigned == _best_sol_indicators.assigned and
+        static_cast<double>(current_sol_indicators.eval.cost) <=
+          best_cost + threshold) {
+      save_routes(accepted_sol, accepted_versions);
+    } else {
+      restore_routes(accepted_sol, accepted_versions);
+    }
+  }
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+void LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::guided_local_search() {
+  if (stop() or _best_sol_indicators.assigned == 0) {
+    return;
+  }
+
+  // Penalized costs are read from a separate instance, so that
+  // evaluations are not impacted for other searches.
+  auto penalized_input = _input.penalizable_input();
+
+  // Locations visited by route at rank v, as pairs of matrix indices
+  // for this instance and penalized instance.
+  auto route_locations = [&](Index v, const std::vector<Index>& route) {
+    std::vector<std::pair<Index, Index>> indices;
+    const auto& vehicle = _input.vehicles[v];
+    const auto& penalized_vehicle = penalized_input.vehicles[v];
+    if (vehicle.has_start()) {
+      indices.emplace_back(vehicle.start.value().index(),
+                           penalized_vehicle.start.value().index());
+    }
+    for (const auto j : route) {
+      indices.emplace_back(_input.jobs[j].index(),
+                           penalized_input.jobs[j].index());
+    }
+    if (vehicle.has_end()) {
+      indices.emplace_back(vehicle.end.value().index(),
+                           penalized_vehicle.end.value().index());
+    }
+    return indices;
+  };
+
+  // Penalty unit is a share of average edge cost in current solution.
+  Cost travel_cost = 0;
+  std::size_t nb_edges = 0;
+  for (std::size_t v = 0; v < _sol.size(); ++v) {
+    if (_sol[v].empty()) {
+      continue;
+    }
+    const auto locations = route_locations(v, _sol[v].route);
+    for (std::size_t i = 0; i + 1 < locations.size(); ++i) {
+      travel_cost +=
+        _input.vehicles[v].cost(locations[i].first, locations[i + 1].first);
+      ++nb_edges;
+    }
+  }
+  const auto unit =
+    std::max(static_cast<Cost>(1),
+             static_cast<Cost>(GLS_PENALTY_FACTOR *
+                               static_cast<double>(travel_cost) /
+                               static_cast<double>(nb_edges)));
+
+  // Number of penalties for each edge, using matrix indices for this
+  // instance.
+  std::map<std::pair<Index, Index>, unsigned> penalties;
+
+  Timeout timeout;
+  if (_deadline.has_value()) {
+    const auto now = utils::now();
+    timeout = (now < _deadline.value())
+                ? std::chrono::duration_cast<std::chrono::milliseconds>(
+                    _deadline.value() - now)
+                : std::chrono::milliseconds(0);
+  }
+  Budget budget;
+  if (_budget.has_value()) {
+    budget = _budget.value() - _nb_steps;
+  }
+  const auto start_steps = _nb_steps;
+
+  std::vector<Route> penalized_sol = _sol;
+  LocalSearch penalized_ls(penalized_input,
+                           penalized_sol,
+                           _max_nb_jobs_removal,
+                           timeout,
+                           budget,
+                           _cancellation);
+  auto& current_sol = penalized_ls._sol;
+
+  while (!stop()) {
+    // Penalize edge with maximum utility in each route, utility being
+    // higher for costly edges with few penalties.
+    for (std::size_t v = 0; v < current_sol.size(); ++v) {
+      if (current_sol[v].empty()) {
+        continue;
+      }
+
+      const auto locations = route_locations(v, current_sol[v].route);
+
+      double best_utility = -1;
+      std::size_t best_rank = 0;
+      for (std::size_t i = 0; i + 1 < locations.size(); ++i) {
+        const std::pair<Index, Index> edge(locations[i].first,
+                                           locations[i + 1].first);
+        const auto search = penalties.find(edge);
+        const auto nb_penalties =
+          (search == penalties.end()) ? 0 : search->second;
+
+        const auto utility =
+          static_cast<double>(_input.vehicles[v].cost(edge.first,
+                                                      edge.second)) /
+          (1 + nb_penalties);
+        if (best_utility < utility) {
+          best_utility = utility;
+          best_rank = i;
+        }
+      }
+
+      const auto& from = locations[best_rank];
+      const auto& to = locations[best_rank + 1];
+      ++penalties[{from.first, to.first}];
+      penalized_input.add_edge_penalty(from.second, to.second, unit);
+    }
+
+    // Penalties change insertion costs in all routes.
+    for (Index v = 0; v < current_sol.size(); ++v) {
+      penalized_ls.set_modified(v);
+    }
+
+    // Descent using penalized costs.
+    const auto setup_start = stats_now();
+    penalized_ls._sol_state.setup(current_sol);
+    penalized_ls.add_elapsed_time(penalized_ls._state_updates_time,
+                                  setup_start);
+
+    penalized_ls.run_ls_step();
+    _nb_steps = start_steps + penalized_ls._nb_steps;
+
+    utils::SolutionIndicators<Route> current_sol_indicators(_input,
+                                                            current_sol);
+    if (current_sol_indicators < _best_sol_indicators) {
+      _sol = current_sol;
+      for (Index v = 0; v < _nb_vehicles; ++v) {
+        set_modified(v);
+      }
+      set_best_sol(current_sol_indicators);
+    }
+  }
+
+  for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+    _operator_stats[op] += penalized_ls._operator_stats[op];
+  }
+  _state_updates_time += penalized_ls._state_updates_time;
+  _job_additions_time += penalized_ls._job_additions_time;
+
+  // Back to best known solution with actual costs. Solution state
+  // is not kept up to date while copying penalized solutions so it
+  // is fully set up again.
+  _sol = _best_sol;
+  _sol_versions = _best_sol_versions;
+  const auto setup_start = stats_now();
+  _sol_state.setup(_sol);
+  add_elapsed_time(_state_updates_time, setup_start);
+}
+
+template <class Route,
+          class UnassignedExchange,
+          class CrossExchange,
+          class MixedExchange,
+          class TwoOpt,
+          class ReverseTwoOpt,
+          class Relocate,
+          class OrOpt,
+          class IntraExchange,
+          class IntraCrossExchange,
+          class IntraMixedExchange,
+          class IntraRelocate,
+          class IntraOrOpt,
+          class IntraTwoOpt,
+          class PDShift,
+          class RouteExchange,
+          class SwapStar,
+          class RouteSplit>
+bool LocalSearch<Route,
+                 UnassignedExchange,
+                 CrossExchange,
+                 MixedExchange,
+                 TwoOpt,
+                 ReverseTwoOpt,
+                 Relocate,
+                 OrOpt,
+                 IntraExchange,
+                 IntraCrossExchange,
+                 IntraMixedExchange,
+                 IntraRelocate,
+                 IntraOrOpt,
+                 IntraTwoOpt,
+                 PDShift,
+                 RouteExchange,
+                 SwapStar,
+                 RouteSplit>::stop() const {
+  return _cancellation.is_cancelled() or
+         (_budget.has_value() and _budget.value() <= _nb_steps) or
+         (_deadline.has_value() and _deadline.value() < utils::now());
+}
+
 template <class Route,
           class UnassignedExchange,
           class CrossExchange,
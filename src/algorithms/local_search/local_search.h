@@ -10,6 +10,15 @@ All rights reserved (see LICENSE).
 
 */
 
+#include <array>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <random>
+
+#include "algorithms/local_search/insertion_search.h"
+#include "algorithms/local_search/move_arena.h"
+#include "structures/generic/bitset.h"
 #include "structures/vroom/solution_indicators.h"
 #include "structures/vroom/solution_state.h"
 
@@ -34,12 +43,21 @@ template <class Route,
           class SwapStar,
           class RouteSplit>
 class LocalSearch {
+public:
+  // Called each time a new best solution is found.
+  using BestSolutionCallback =
+    std::function<void(const std::vector<Route>&,
+                       const utils::SolutionIndicators<Route>&)>;
+
 private:
   const Input& _input;
   const std::size_t _nb_vehicles;
 
   const unsigned _max_nb_jobs_removal;
   const Deadline _deadline;
+  const Budget _budget;
+  uint64_t _nb_steps{0};
+  const CancellationToken _cancellation;
 
   std::vector<Index> _all_routes;
 
@@ -49,14 +67,90 @@ private:
 
   std::vector<Route>& _best_sol;
   utils::SolutionIndicators<Route> _best_sol_indicators;
-
-#ifdef LOG_LS_OPERATORS
-  // Store operator usage stats.
-  std::array<unsigned, OperatorName::MAX> tried_moves;
-  std::array<unsigned, OperatorName::MAX> applied_moves;
-#endif
-
-  void try_job_additions(const std::vector<Index>& routes, double regret_coeff);
+  const BestSolutionCallback _best_sol_callback;
+
+  // Each route modification in _sol sets a new version for that
+  // route, so that snapshots only copy or restore routes that differ.
+  uint64_t _last_version{0};
+  std::vector<uint64_t> _sol_versions;
+  std::vector<uint64_t> _best_sol_versions;
+
+  // _insertions[v][j] is the best insertion of job j in route v
+  // including fixed cost, valid if _insertion_versions[v][j] matches
+  // current version of route v. Rows are allocated upon first use
+  // for a route and entries are only set for unassigned jobs.
+  std::vector<std::vector<std::optional<RouteInsertion>>> _insertions;
+  std::vector<std::vector<uint64_t>> _insertion_versions;
+
+  // Route versions at the end of last run_ls_step that was not
+  // stopped, at which point no pair of different routes holds an
+  // improving move. Such pairs are skipped in the next steps while
+  // both routes are unchanged.
+  std::vector<uint64_t> _local_optimum_versions;
+
+  // Best move found for each pair of routes.
+  MoveArena<UnassignedExchange,
+            CrossExchange,
+            MixedExchange,
+            TwoOpt,
+            ReverseTwoOpt,
+            Relocate,
+            OrOpt,
+            IntraExchange,
+            IntraCrossExchange,
+            IntraMixedExchange,
+            IntraRelocate,
+            IntraOrOpt,
+            IntraTwoOpt,
+            PDShift,
+            RouteExchange,
+            SwapStar,
+            RouteSplit>
+    _best_ops;
+
+  // Operators stats are also used to skip operators that rarely
+  // provide the applied move. Adaptive operator selection is only on
+  // for large instances and only relies on move counts so that
+  // results stay reproducible.
+  const bool _adaptive_operators;
+  std::array<OperatorStats, OperatorName::MAX> _operator_stats;
+
+  // Only measured when solving stats are required.
+  std::chrono::nanoseconds _state_updates_time{0};
+  std::chrono::nanoseconds _job_additions_time{0};
+
+  // Used for ruin and recreate choices, default seed makes results
+  // reproducible.
+  std::mt19937 _rng;
+
+  // Compute insertions of unassigned jobs in route v that are not up
+  // to date.
+  void update_insertions(Index v);
+
+  // When noise is not zero, insertion costs are randomly scaled by a
+  // factor in [1 - noise, 1 + noise] for job and route choices.
+  void try_job_additions(const std::vector<Index>& routes,
+                         double regret_coeff,
+                         double noise = 0);
+
+  // Current time if solving stats are required, avoids reading the
+  // clock otherwise.
+  TimePoint stats_now() const {
+    return _input.get_solving_stats() ? utils::now() : TimePoint();
+  }
+
+  // Add time elapsed since start to given counter, if solving stats
+  // are required.
+  void add_elapsed_time(std::chrono::nanoseconds& counter,
+                        const TimePoint& start) {
+    if (_input.get_solving_stats()) {
+      counter += utils::now() - start;
+    }
+  }
+
+  // Operators to evaluate in next local search iteration, all of
+  // them unless adaptive operator selection is on.
+  std::array<bool, OperatorName::MAX> active_operators() const;
 
   void run_ls_step();
 
@@ -73,19 +167,86 @@ private:
 
   void remove_from_routes();
 
+  enum class RUIN { RANDOM, STRING, DISTANCE, TIME_WINDOW, ROUTE };
+
+  // Pick up to nb_jobs assigned jobs to remove using given ruin
+  // operator, shipments being picked as a whole.
+  utils::Bitset select_ruined_jobs(RUIN ruin, unsigned nb_jobs);
+
+  // Remove selected jobs from routes, except for routes where removal
+  // would be invalid.
+  void remove_jobs(const utils::Bitset& ruined);
+
+  // Repeatedly ruin current solution, refill it and apply local
+  // search, as long as time or budget allows. Degraded solutions are
+  // accepted using a record-to-record criterion with a threshold
+  // shrinking along the way.
+  void ruin_and_recreate();
+
+  // Repeatedly penalize costly edges that are rarely penalized in
+  // current solution and apply local search using penalized costs,
+  // as long as time or budget allows. Solutions are compared using
+  // actual costs.
+  void guided_local_search();
+
+  // True when search should stop due to cancellation, deadline or
+  // budget.
+  bool stop() const;
+
+  void set_modified(Index v) {
+    _sol_versions[v] = ++_last_version;
+  }
+
+  // Copy routes from _sol that differ in snapshot.
+  void save_routes(std::vector<Route>& snapshot,
+                   std::vector<uint64_t>& snapshot_versions) const;
+
+  // Restore routes from snapshot that differ in _sol, solution state
+  // being only updated for those routes.
+  void restore_routes(const std::vector<Route>& snapshot,
+                      const std::vector<uint64_t>& snapshot_versions);
+
+  void set_best_sol(const utils::SolutionIndicators<Route>& indicators);
+
 public:
   LocalSearch(const Input& input,
               std::vector<Route>& tw_sol,
               unsigned max_nb_jobs_removal,
-              const Timeout& timeout);
+              const Timeout& timeout,
+              const Budget& budget = Budget(),
+              const CancellationToken& cancellation = CancellationToken(),
+              const BestSolutionCallback& best_sol_callback =
+                BestSolutionCallback());
 
   utils::SolutionIndicators<Route> indicators() const;
 
+  // Greedily insert unassigned jobs in current solution, useful when
+  // starting from a partial solution.
+  void insert_unassigned();
+
+  // Apply local search until no improvement is found or search has
+  // to stop.
+  void descend();
+
+  // Descent followed by an escape phase using remaining time or
+  // budget, if any.
   void run();
 
-#ifdef LOG_LS_OPERATORS
+  uint64_t get_nb_steps() const {
+    return _nb_steps;
+  }
+
   std::array<OperatorStats, OperatorName::MAX> get_stats() const;
-#endif
+
+  // Time spent on solution state updates and job additions, only
+  // measured when solving stats are required.
+  std::chrono::nanoseconds get_state_updates_time() const {
+    return _state_updates_time;
+  }
+
+  std::chrono::nanoseconds get_job_additions_time() const {
+    return _job_additions_time;
+  }
 };
 
 } // namespace vroom::ls
@@ -0,0 +1,102 @@
+#ifndef MOVE_ARENA_H
+#define MOVE_ARENA_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <limits>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "algorithms/local_search/operator.h"
+
+namespace vroom::ls {
+
+// Store best move for each pair of routes by value in a pool of
+// slots that is reused throughout the search, so that recording or
+// dropping moves does not involve memory allocation once the pool
+// has grown to the number of moves stored at the same time.
+template <class... Operators> class MoveArena {
+private:
+  using Move = std::variant<std::monostate, Operators...>;
+
+  static constexpr unsigned NO_SLOT = std::numeric_limits<unsigned>::max();
+
+  const std::size_t _nb_vehicles;
+
+  // _slots[s * _nb_vehicles + t] is the rank in _moves of the move
+  // stored for source s and target t, or NO_SLOT.
+  std::vector<unsigned> _slots;
+  std::vector<Move> _moves;
+  std::vector<unsigned> _free_slots;
+
+public:
+  MoveArena(std::size_t nb_vehicles)
+    : _nb_vehicles(nb_vehicles), _slots(nb_vehicles * nb_vehicles, NO_SLOT) {
+  }
+
+  // Replace move stored for given pair with op.
+  template <class Op> void store(Index source, Index target, Op&& op) {
+    auto& slot = _slots[source * _nb_vehicles + target];
+
+    if (slot == NO_SLOT) {
+      if (_free_slots.empty()) {
+        slot = _moves.size();
+        _moves.emplace_back();
+      } else {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+      }
+    }
+
+    _moves[slot].template emplace<std::decay_t<Op>>(std::forward<Op>(op));
+  }
+
+  // Move stored for given pair, or nullptr if there is none. Only
+  // valid until next call to store.
+  Operator* get(Index source, Index target) {
+    const auto slot = _slots[source * _nb_vehicles + target];
+    if (slot == NO_SLOT) {
+      return nullptr;
+    }
+
+    return std::visit(
+      [](auto& move) -> Operator* {
+        if constexpr (std::is_same_v<std::decay_t<decltype(move)>,
+                                     std::monostate>) {
+          return nullptr;
+        } else {
+          return &move;
+        }
+      },
+      _moves[slot]);
+  }
+
+  void clear(Index source, Index target) {
+    auto& slot = _slots[source * _nb_vehicles + target];
+    if (slot != NO_SLOT) {
+      _moves[slot].template emplace<std::monostate>();
+      _free_slots.push_back(slot);
+      slot = NO_SLOT;
+    }
+  }
+
+  void clear() {
+    for (Index s = 0; s < _nb_vehicles; ++s) {
+      for (Index t = 0; t < _nb_vehicles; ++t) {
+        clear(s, t);
+      }
+    }
+  }
+};
+
+} // namespace vroom::ls
+
+#endif
@@ -31,6 +31,7 @@ int main(int argc, char** argv) {
   std::vector<std::string> port_args;
   std::string router_arg;
   std::string limit_arg;
+  std::string budget_arg;
   std::vector<std::string> heuristic_params_arg;
 
   cxxopts::Options options("vroom",
@@ -50,12 +51,24 @@ int main(int argc, char** argv) {
     ("a,host",
      "host for the routing profile",
      cxxopts::value<std::vector<std::string>>(host_args)->default_value({vroom::DEFAULT_PROFILE + ":0.0.0.0"}))
+    ("budget",
+     "stop local search after 'budget' steps, for reproducible results",
+     cxxopts::value<std::string>(budget_arg))
     ("c,choose-eta",
      "choose ETA for custom routes and report violations",
      cxxopts::value<bool>(cl_args.check)->default_value("false"))
+    ("decompose",
+     "solve larger instances using sub-problems of around 'decompose' jobs",
+     cxxopts::value<std::size_t>(cl_args.decomposition_size)->default_value("0"))
+    ("genetic",
+     "evolve a population of solutions using 'limit' or 'budget'",
+     cxxopts::value<bool>(cl_args.genetic_search)->default_value("false"))
     ("g,geometry",
      "add detailed route geometry and distance",
      cxxopts::value<bool>(cl_args.geometry)->default_value("false"))
+    ("gls",
+     "escape local optima using guided local search with 'limit' or 'budget'",
+     cxxopts::value<bool>(cl_args.guided_local_search)->default_value("false"))
     ("h,help", "display this help and exit")
     ("i,input",
      "read input from a file rather than from stdin",
@@ -66,16 +79,28 @@ int main(int argc, char** argv) {
     ("o,output",
      "write output to a file rather than stdout",
      cxxopts::value<std::string>(cl_args.output_file))
+    ("progress",
+     "write solving progress as json lines to a file",
+     cxxopts::value<std::string>(cl_args.progress_file))
+    ("progress-solution",
+     "add best solution to progress lines",
+     cxxopts::value<bool>(cl_args.progress_with_solution)->default_value("false"))
     ("p,port",
      "host port for the routing profile",
      cxxopts::value<std::vector<std::string>>(port_args)->default_value({vroom::DEFAULT_PROFILE + ":5000"}))
     ("r,router",
      "osrm, libosrm, ors or valhalla",
      cxxopts::value<std::string>(router_arg)->default_value("osrm"))
+    ("stats",
+     "report operators stats, phases timings and threads usage in summary",
+     cxxopts::value<bool>(cl_args.solving_stats)->default_value("false"))
     ("t,threads",
      "number of available threads",
      cxxopts::value<unsigned>(cl_args.nb_threads)->default_value(std::to_string(vroom::DEFAULT_THREADS_NUMBER)))
     ("v,version", "output version information and exit")
+    ("w,warm-start",
+     "read a previous solution from a file and use it as a starting point (not compatible with vehicle steps)",
+     cxxopts::value<std::string>(cl_args.previous_solution_file))
     ("x,explore",
      "exploration level to use (0..5)",
      cxxopts::value<unsigned>(cl_args.exploration_level)->default_value(std::to_string(vroom::DEFAULT_EXPLORATION_LEVEL)))
@@ -108,6 +133,15 @@ int main(int argc, char** argv) {
                                      "' failed to parse");
     }
 
+    try {
+      if (!budget_arg.empty()) {
+        cl_args.budget = std::stoull(budget_arg);
+      }
+    } catch (const std::exception& e) {
+      throw cxxopts::OptionException("Argument '" + budget_arg +
+                                     "' failed to parse");
+    }
+
     if (parsed_args.count("help") != 0) {
       std::cout << options.help({"Solving"}) << "\n";
       exit(0);
@@ -186,14 +220,46 @@ int main(int argc, char** argv) {
   try {
     // Build problem.
     vroom::Input problem_instance(cl_args.servers, cl_args.router);
-    vroom::io::parse(problem_instance, cl_args.input, cl_args.geometry);
+    vroom::io::parse(problem_instance,
+                     cl_args.input,
+                     cl_args.geometry,
+                     cl_args.nb_threads);
+    problem_instance.set_decomposition_size(cl_args.decomposition_size);
+    problem_instance.set_solving_stats(cl_args.solving_stats);
+    problem_instance.set_guided_local_search(cl_args.guided_local_search);
+    problem_instance.set_genetic_search(cl_args.genetic_search);
+
+    if (!cl_args.previous_solution_file.empty()) {
+      std::ifstream ifs(cl_args.previous_solution_file);
+      std::stringstream buffer;
+      buffer << ifs.rdbuf();
+      vroom::io::parse_previous_solution(problem_instance, buffer.str());
+    }
+
+    std::ofstream progress_stream;
+    vroom::ProgressCallback progress;
+    if (!cl_args.progress_file.empty()) {
+      progress_stream.open(cl_args.progress_file, std::ofstream::out);
+      if (!progress_stream) {
+        throw vroom::InputException("Can't open progress file " +
+                                    cl_args.progress_file + ".");
+      }
+      progress = [&](const vroom::Progress& p) {
+        vroom::io::write_to_json(p, progress_stream);
+      };
+    }
 
     vroom::Solution sol = (cl_args.check)
                             ? problem_instance.check(cl_args.nb_threads)
                             : problem_instance.solve(cl_args.exploration_level,
                                                      cl_args.nb_threads,
                                                      cl_args.timeout,
-                                                     cl_args.h_params);
+                                                     cl_args.h_params,
+                                                     progress,
+                                                     cl_args
+                                                       .progress_with_solution,
+                                                     vroom::CancellationToken(),
+                                                     cl_args.budget);
 
     // Write solution.
     vroom::io::write_to_json(sol, cl_args.geometry, cl_args.output_file);
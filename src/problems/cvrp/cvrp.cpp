@@ -142,7 +142,11 @@ CVRP::CVRP(const Input& input) : VRP(input) {
 Solution CVRP::solve(unsigned exploration_level,
                      unsigned nb_threads,
                      const Timeout& timeout,
-                     const std::vector<HeuristicParameters>& h_param) const {
+                     const std::vector<HeuristicParameters>& h_param,
+                     const ProgressCallback& progress,
+                     bool progress_with_solution,
+                     const CancellationToken& cancellation,
+                     const Budget& budget) const {
   if (_input.vehicles.size() == 1 and !_input.has_skills() and
       _input.zero_amount().size() == 0 and !_input.has_shipments() and
       (_input.jobs.size() <= _input.vehicles[0].max_tasks) and
@@ -153,16 +157,24 @@ Solution CVRP::solve(unsigned exploration_level,
 
     TSP p(_input, job_ranks, 0);
 
-    RawRoute r(_input, 0, 0);
-    r.set_route(_input, p.raw_solve(nb_threads, timeout));
-
-    return utils::format_solution(_input, {r});
+    return p.solve(exploration_level,
+                   nb_threads,
+                   timeout,
+                   h_param,
+                   progress,
+                   progress_with_solution,
+                   cancellation,
+                   budget);
   }
 
   return VRP::solve<RawRoute, cvrp::LocalSearch>(exploration_level,
                                                  nb_threads,
                                                  timeout,
                                                  h_param,
+                                                 progress,
+                                                 progress_with_solution,
+                                                 cancellation,
+                                                 budget,
                                                  homogeneous_parameters,
                                                  heterogeneous_parameters);
 }
@@ -24,11 +24,14 @@ private:
 public:
   CVRP(const Input& input);
 
-  Solution
-  solve(unsigned exploration_level,
-        unsigned nb_threads,
-        const Timeout& timeout,
-        const std::vector<HeuristicParameters>& h_param) const override;
+  Solution solve(unsigned exploration_level,
+                 unsigned nb_threads,
+                 const Timeout& timeout,
+                 const std::vector<HeuristicParameters>& h_param,
+                 const ProgressCallback& progress,
+                 bool progress_with_solution,
+                 const CancellationToken& cancellation,
+                 const Budget& budget) const override;
 };
 
 } // namespace vroom
@@ -14,7 +14,7 @@ namespace vroom::cvrp {
 
 UnassignedExchange::UnassignedExchange(const Input& input,
                                        const utils::SolutionState& sol_state,
-                                       std::unordered_set<Index>& unassigned,
+                                       utils::SparseSet& unassigned,
                                        RawRoute& s_raw_route,
                                        Index s_vehicle,
                                        Index s_rank,
@@ -135,9 +135,9 @@ void UnassignedExchange::apply() {
             _moved_jobs.end(),
             s_route.begin() + _first_rank);
 
-  assert(_unassigned.find(_u) != _unassigned.end());
+  assert(_unassigned.contains(_u));
   _unassigned.erase(_u);
-  assert(_unassigned.find(_removed) == _unassigned.end());
+  assert(!_unassigned.contains(_removed));
   _unassigned.insert(_removed);
 
   source.update_amounts(_input);
@@ -21,12 +21,16 @@ namespace vroom::tsp {
 LocalSearch::LocalSearch(const Matrix<UserCost>& matrix,
                          std::pair<bool, Index> avoid_start_relocate,
                          const std::list<Index>& tour,
-                         unsigned nb_threads)
+                         unsigned nb_threads,
+                         const CancellationToken& cancellation,
+                         const Budget& budget)
   : _matrix(matrix),
     _avoid_start_relocate(std::move(avoid_start_relocate)),
     _edges(_matrix.size()),
     _nb_threads(std::min(nb_threads, static_cast<unsigned>(tour.size()))),
-    _rank_limits(_nb_threads) {
+    _rank_limits(_nb_threads),
+    _cancellation(cancellation),
+    _budget(budget) {
   // Build _edges vector representation.
   auto location = tour.cbegin();
   Index first_index = *location;
@@ -100,6 +104,12 @@ LocalSearch::LocalSearch(const Matrix<UserCost>& matrix,
   _sym_two_opt_rank_limits.push_back(_edges.size());
 }
 
+bool LocalSearch::stop(const Deadline& deadline) const {
+  return _cancellation.is_cancelled() or
+         (_budget.has_value() and _budget.value() <= _nb_steps) or
+         (deadline.has_value() and deadline.value() < utils::now());
+}
+
 UserCost LocalSearch::relocate_step() {
   if (_edges.size() < 3) {
     // Not enough edges for the operator to make sense.
@@ -216,9 +226,10 @@ UserCost LocalSearch::perform_all_relocate_steps(const Deadline& deadline) {
   unsigned relocate_iter = 0;
   UserCost gain = 0;
   do {
-    if (deadline.has_value() and deadline.value() < utils::now()) {
+    if (stop(deadline)) {
       break;
     }
+    ++_nb_steps;
 
     gain = this->relocate_step();
 
@@ -370,9 +381,10 @@ UserCost LocalSearch::perform_all_avoid_loop_steps(const Deadline& deadline) {
   unsigned relocate_iter = 0;
   UserCost gain = 0;
   do {
-    if (deadline.has_value() and deadline.value() < utils::now()) {
+    if (stop(deadline)) {
       break;
     }
+    ++_nb_steps;
 
     gain = this->avoid_loop_step();
 
@@ -638,9 +650,10 @@ UserCost LocalSearch::perform_all_two_opt_steps(const Deadline& deadline) {
   unsigned two_opt_iter = 0;
   UserCost gain = 0;
   do {
-    if (deadline.has_value() and deadline.value() < utils::now()) {
+    if (stop(deadline)) {
       break;
     }
+    ++_nb_steps;
 
     gain = this->two_opt_step();
 
@@ -658,9 +671,10 @@ UserCost LocalSearch::perform_all_asym_two_opt_steps(const Deadline& deadline) {
   unsigned two_opt_iter = 0;
   UserCost gain = 0;
   do {
-    if (deadline.has_value() and deadline.value() < utils::now()) {
+    if (stop(deadline)) {
       break;
     }
+    ++_nb_steps;
 
     gain = this->asym_two_opt_step();
 
@@ -777,9 +791,10 @@ UserCost LocalSearch::perform_all_or_opt_steps(const Deadline& deadline) {
   unsigned or_opt_iter = 0;
   UserCost gain = 0;
   do {
-    if (deadline.has_value() and deadline.value() < utils::now()) {
+    if (stop(deadline)) {
       break;
     }
+    ++_nb_steps;
 
     gain = this->or_opt_step();
     if (gain > 0) {
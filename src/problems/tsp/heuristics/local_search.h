@@ -12,6 +12,7 @@ All rights reserved (see LICENSE).
 
 #include "structures/generic/matrix.h"
 #include "structures/typedefs.h"
+#include "structures/vroom/cancellation_token.h"
 
 namespace vroom::tsp {
 
@@ -23,12 +24,23 @@ private:
   unsigned _nb_threads;
   std::vector<Index> _rank_limits;
   std::vector<Index> _sym_two_opt_rank_limits;
+  const CancellationToken _cancellation;
+  const Budget _budget;
+  uint64_t _nb_steps{0};
+
+  bool stop(const Deadline& deadline) const;
 
 public:
   LocalSearch(const Matrix<UserCost>& matrix,
               std::pair<bool, Index> avoid_start_relocate,
               const std::list<Index>& tour,
-              unsigned nb_threads);
+              unsigned nb_threads,
+              const CancellationToken& cancellation,
+              const Budget& budget = Budget());
+
+  uint64_t nb_steps() const {
+    return _nb_steps;
+  }
 
   UserCost relocate_step();
 
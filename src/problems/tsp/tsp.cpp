@@ -158,7 +158,9 @@ UserCost TSP::symmetrized_cost(const std::list<Index>& tour) const {
 }
 
 std::vector<Index> TSP::raw_solve(unsigned nb_threads,
-                                  const Timeout& timeout) const {
+                                  const Timeout& timeout,
+                                  const CancellationToken& cancellation,
+                                  const Budget& budget) const {
   // Compute deadline including heuristic computing time.
   const Deadline deadline =
     timeout.has_value() ? utils::now() + timeout.value() : Deadline();
@@ -166,12 +168,13 @@ std::vector<Index> TSP::raw_solve(unsigned nb_threads,
   // Applying heuristic.
   std::list<Index> christo_sol = tsp::christofides(_symmetrized_matrix);
 
+  // Rule of thumb if problem is asymmetric: dedicate 70% of the
+  // remaining available solving time (or steps) to the symmetric
+  // local search, then the rest to the asymmetric version.
+  constexpr double sym_ls_ratio = 0.7;
+
   Deadline sym_deadline = deadline;
   if (deadline.has_value() and !_is_symmetric) {
-    // Rule of thumb if problem is asymmetric: dedicate 70% of the
-    // remaining available solving time to the symmetric local search,
-    // then the rest to the asymmetric version.
-    constexpr double sym_ls_ratio = 0.7;
     const auto after_heuristic = utils::now();
     const auto remaining_ms =
       (after_heuristic < deadline.value())
@@ -184,6 +187,11 @@ std::vector<Index> TSP::raw_solve(unsigned nb_threads,
                           static_cast<unsigned>(sym_ls_ratio * remaining_ms));
   }
 
+  Budget sym_budget = budget;
+  if (budget.has_value() and !_is_symmetric) {
+    sym_budget = static_cast<uint64_t>(sym_ls_ratio * budget.value());
+  }
+
   // Local search on symmetric problem.
   // Applying deterministic, fast local search to improve the current
   // solution in a small amount of time. All possible moves for the
@@ -194,7 +202,9 @@ std::vector<Index> TSP::raw_solve(unsigned nb_threads,
                                            _has_end,
                                          _start),
                           christo_sol,
-                          nb_threads);
+                          nb_threads,
+                          cancellation,
+                          sym_budget);
 
   UserCost sym_two_opt_gain = 0;
   UserCost sym_relocate_gain = 0;
@@ -232,12 +242,21 @@ std::vector<Index> TSP::raw_solve(unsigned nb_threads,
     UserCost direct_cost = this->cost(current_sol);
     UserCost reverse_cost = this->cost(reverse_current_sol);
 
+    // Asymmetric local search gets the steps left unused.
+    Budget asym_budget = budget;
+    if (budget.has_value()) {
+      asym_budget =
+        budget.value() - std::min(budget.value(), sym_ls.nb_steps());
+    }
+
     // Local search on asymmetric problem.
     tsp::LocalSearch
       asym_ls(_matrix,
               std::make_pair(!_round_trip and _has_start and _has_end, _start),
               (direct_cost <= reverse_cost) ? current_sol : reverse_current_sol,
-              nb_threads);
+              nb_threads,
+              cancellation,
+              asym_budget);
 
     UserCost asym_two_opt_gain = 0;
     UserCost asym_relocate_gain = 0;
@@ -294,10 +313,37 @@ std::vector<Index> TSP::raw_solve(unsigned nb_threads,
 Solution TSP::solve(unsigned,
                     unsigned nb_threads,
                     const Timeout& timeout,
-                    const std::vector<HeuristicParameters>&) const {
+                    const std::vector<HeuristicParameters>&,
+                    const ProgressCallback& progress,
+                    bool progress_with_solution,
+                    const CancellationToken& cancellation,
+                    const Budget& budget) const {
+  const auto solving_start = utils::now();
+
   RawRoute r(_input, 0, 0);
-  r.set_route(_input, raw_solve(nb_threads, timeout));
-  return utils::format_solution(_input, {r});
+  r.set_route(_input, raw_solve(nb_threads, timeout, cancellation, budget));
+  auto sol = utils::format_solution(_input, {r});
+
+  // The TSP solving pipeline has no intermediate solutions, so only
+  // the final one is reported.
+  if (progress) {
+    const auto solving = std::chrono::duration_cast<std::chrono::milliseconds>(
+      utils::now() - solving_start);
+    const auto& summary = sol.summary;
+    Progress current(solving.count(),
+                     summary.priority,
+                     _input.jobs.size() - summary.unassigned,
+                     summary.unassigned,
+                     summary.cost,
+                     summary.duration,
+                     summary.routes);
+    if (progress_with_solution) {
+      current.solution.emplace(sol);
+    }
+    progress(current);
+  }
+
+  return sol;
 }
 
 } // namespace vroom
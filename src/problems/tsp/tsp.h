@@ -41,13 +41,20 @@ private:
 public:
   TSP(const Input& input, std::vector<Index> job_ranks, Index vehicle_rank);
 
-  std::vector<Index> raw_solve(unsigned nb_threads,
-                               const Timeout& timeout) const;
+  std::vector<Index>
+  raw_solve(unsigned nb_threads,
+            const Timeout& timeout,
+            const CancellationToken& cancellation = CancellationToken(),
+            const Budget& budget = Budget()) const;
 
   Solution solve(unsigned,
                  unsigned nb_threads,
                  const Timeout& timeout,
-                 const std::vector<HeuristicParameters>&) const override;
+                 const std::vector<HeuristicParameters>&,
+                 const ProgressCallback&,
+                 bool,
+                 const CancellationToken& cancellation,
+                 const Budget& budget) const override;
 };
 
 } // namespace vroom
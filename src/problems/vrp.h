@@ -13,10 +13,15 @@ All rights reserved (see LICENSE).
 #include <mutex>
 #include <set>
 #include <thread>
+#include <unordered_set>
 
+#include "algorithms/decomposition/decomposition.h"
+#include "algorithms/genetic/genetic.h"
 #include "algorithms/heuristics/heuristics.h"
+#include "algorithms/heuristics/portfolio.h"
 #include "algorithms/local_search/local_search.h"
 #include "structures/vroom/input/input.h"
+#include "structures/vroom/solution/progress.h"
 #include "structures/vroom/solution/solution.h"
 
 namespace vroom {
@@ -32,8 +37,14 @@ protected:
     unsigned nb_threads,
     const Timeout& timeout,
     const std::vector<HeuristicParameters>& h_param,
+    const ProgressCallback& progress,
+    bool progress_with_solution,
+    const CancellationToken& cancellation,
+    const Budget& budget,
     const std::vector<HeuristicParameters>& homogeneous_parameters,
     const std::vector<HeuristicParameters>& heterogeneous_parameters) const {
+    const auto solving_start = utils::now();
+
     // Use vector of parameters when passed for debugging, else use
     // predefined parameter set.
     const auto& parameters = (!h_param.empty()) ? h_param
@@ -55,43 +66,168 @@ protected:
     }
     assert(nb_init_solutions <= parameters.size());
 
-    std::vector<std::vector<Route>> solutions(nb_init_solutions);
-
-    // Split the heuristic parameters among threads.
-    std::vector<std::vector<std::size_t>>
-      thread_ranks(nb_threads, std::vector<std::size_t>());
-    for (std::size_t i = 0; i < nb_init_solutions; ++i) {
-      thread_ranks[i % nb_threads].push_back(i);
+    // Predefined parameters are adjusted to the instance at hand and
+    // the ones bound to provide the same solution are dropped.
+    auto candidates =
+      (!h_param.empty())
+        ? h_param
+        : heuristics::get_portfolio(heuristics::InstanceFeatures(_input),
+                                    parameters,
+                                    nb_init_solutions);
+
+    // Also try ordering vehicles by cost for each heuristic run.
+    const bool try_cost_sort =
+      !_input.has_homogeneous_costs() and h_param.empty();
+
+    // Shared across all heuristic runs, only built if a candidate
+    // actually uses it. Perturbed variants use the same heuristics
+    // and sort values as candidates.
+    std::optional<heuristics::HeuristicContext> context;
+    std::set<SORT> regret_sorts;
+    bool use_context = false;
+    for (const auto& p : candidates) {
+      if (p.heuristic == HEURISTIC::INIT_ROUTES or
+          p.heuristic == HEURISTIC::WARM_START) {
+        continue;
+      }
+      use_context = true;
+      if (p.heuristic == HEURISTIC::BASIC) {
+        regret_sorts.insert(p.sort);
+        if (try_cost_sort) {
+          regret_sorts.insert(SORT::COST);
+        }
+      }
+    }
+    if (use_context) {
+      context.emplace(_input, regret_sorts);
     }
 
+    std::vector<std::vector<Route>> solutions;
+
+    // Heuristics are run by waves, a wave holding the solutions for
+    // candidates[wave_first] onward.
+    std::size_t wave_first = 0;
+    std::vector<std::vector<Route>> wave_solutions;
+    std::vector<uint64_t> wave_fingerprints;
+    std::vector<std::chrono::nanoseconds> wave_times;
+    std::vector<std::vector<std::size_t>> thread_ranks;
+    unsigned heuristic_nb_threads = 1;
+
+    // Time spent working by each thread, for solving stats.
+    std::vector<std::chrono::nanoseconds> thread_busy(nb_threads);
+
     std::exception_ptr ep = nullptr;
     std::mutex ep_m;
 
+    // Only publish solutions improving on the best one reported so
+    // far across all threads. Filtering and copying the solution
+    // happen under progress_m, formatting happens outside of it so
+    // that other threads are not held back, then reports are
+    // published in order under publish_m, dropping any report
+    // superseded while it was being formatted.
+    std::optional<utils::SolutionIndicators<Route>> progress_indicators;
+    std::size_t progress_seq = 0;
+    std::size_t published_seq = 0;
+    std::mutex progress_m;
+    std::mutex publish_m;
+
+    auto report_progress =
+      [&](const std::vector<Route>& sol,
+          const utils::SolutionIndicators<Route>& indicators) {
+        std::size_t seq;
+        std::optional<std::vector<Route>> sol_copy;
+        {
+          std::lock_guard<std::mutex> lock(progress_m);
+          if (progress_indicators.has_value() and
+              !(indicators < progress_indicators.value())) {
+            return;
+          }
+          progress_indicators = indicators;
+          seq = ++progress_seq;
+          if (progress_with_solution) {
+            sol_copy.emplace(sol);
+          }
+        }
+
+        const auto solving =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            utils::now() - solving_start);
+        const auto& eval = indicators.eval;
+        Progress current(solving.count(),
+                         indicators.priority_sum,
+                         indicators.assigned,
+                         _input.jobs.size() - indicators.assigned,
+                         utils::scale_to_user_cost(eval.cost),
+                         utils::scale_to_user_duration(eval.duration),
+                         indicators.used_vehicles);
+        if (sol_copy.has_value()) {
+          current.solution.emplace(
+            utils::format_solution(_input, sol_copy.value()));
+        }
+
+        std::lock_guard<std::mutex> lock(publish_m);
+        if (seq < published_seq) {
+          return;
+        }
+        published_seq = seq;
+        progress(current);
+      };
+
     auto run_heuristics = [&](const std::vector<std::size_t>& param_ranks) {
       try {
         for (auto rank : param_ranks) {
-          const auto& p = parameters[rank];
+          const auto heuristic_start = utils::now();
+          const auto& p = candidates[wave_first + rank];
 
           switch (p.heuristic) {
           case HEURISTIC::INIT_ROUTES:
-            solutions[rank] =
+            wave_solutions[rank] =
               heuristics::initial_routes<std::vector<Route>>(_input);
             break;
+          case HEURISTIC::WARM_START:
+            wave_solutions[rank] =
+              heuristics::repair_routes<std::vector<Route>>(_input);
+            break;
           case HEURISTIC::BASIC:
-            solutions[rank] =
+            wave_solutions[rank] =
               heuristics::basic<std::vector<Route>>(_input,
+                                                    context.value(),
                                                     p.init,
                                                     p.regret_coeff,
-                                                    p.sort);
+                                                    p.sort,
+                                                    cancellation);
             break;
           case HEURISTIC::DYNAMIC:
-            solutions[rank] = heuristics::dynamic_vehicle_choice<
-              std::vector<Route>>(_input, p.init, p.regret_coeff, p.sort);
+            wave_solutions[rank] =
+              heuristics::dynamic_vehicle_choice<std::vector<Route>>(
+                _input,
+                context.value(),
+                p.init,
+                p.regret_coeff,
+                p.sort,
+                cancellation);
+            break;
+          case HEURISTIC::REGRET:
+            wave_solutions[rank] =
+              heuristics::regret_insertion<std::vector<Route>>(
+                _input,
+                context.value(),
+                p.regret_coeff,
+                p.sort,
+                heuristic_nb_threads,
+                cancellation);
+            break;
+          case HEURISTIC::CLUSTERING:
+            wave_solutions[rank] =
+              heuristics::clustering<std::vector<Route>>(_input,
+                                                         context.value(),
+                                                         p.sort,
+                                                         heuristic_nb_threads,
+                                                         cancellation);
             break;
           }
 
-          if (!_input.has_homogeneous_costs() and
-              p.heuristic != HEURISTIC::INIT_ROUTES and h_param.empty() and
+          if (try_cost_sort and p.heuristic != HEURISTIC::INIT_ROUTES and
               p.sort == SORT::CAPACITY) {
             // Worth trying another vehicle ordering scheme in
             // heuristic.
@@ -99,33 +235,70 @@ protected:
 
             switch (p.heuristic) {
             case HEURISTIC::INIT_ROUTES:
+            case HEURISTIC::WARM_START:
               assert(false);
               break;
             case HEURISTIC::BASIC:
               other_sol = heuristics::basic<std::vector<Route>>(_input,
+                                                                context.value(),
                                                                 p.init,
                                                                 p.regret_coeff,
-                                                                SORT::COST);
+                                                                SORT::COST,
+                                                                cancellation);
               break;
             case HEURISTIC::DYNAMIC:
               other_sol = heuristics::dynamic_vehicle_choice<
-                std::vector<Route>>(_input, p.init, p.regret_coeff, SORT::COST);
+                std::vector<Route>>(_input,
+                                    context.value(),
+                                    p.init,
+                                    p.regret_coeff,
+                                    SORT::COST,
+                                    cancellation);
+              break;
+            case HEURISTIC::REGRET:
+              other_sol =
+                heuristics::regret_insertion<std::vector<Route>>(
+                  _input,
+                  context.value(),
+                  p.regret_coeff,
+                  SORT::COST,
+                  heuristic_nb_threads,
+                  cancellation);
+              break;
+            case HEURISTIC::CLUSTERING:
+              other_sol =
+                heuristics::clustering<std::vector<Route>>(_input,
+                                                           context.value(),
+                                                           SORT::COST,
+                                                           heuristic_nb_threads,
+                                                           cancellation);
               break;
             }
 
             Eval eval;
             Eval other_eval;
             for (Index v = 0; v < _input.vehicles.size(); ++v) {
-              eval += utils::route_eval_for_vehicle(_input,
-                                                    v,
-                                                    solutions[rank][v].route);
+              eval +=
+                utils::route_eval_for_vehicle(_input,
+                                              v,
+                                              wave_solutions[rank][v].route);
               other_eval +=
                 utils::route_eval_for_vehicle(_input, v, other_sol[v].route);
             }
             if (other_eval < eval) {
-              solutions[rank] = std::move(other_sol);
+              wave_solutions[rank] = std::move(other_sol);
             }
           }
+
+          if (progress) {
+            const utils::SolutionIndicators<Route>
+              indicators(_input, wave_solutions[rank]);
+            report_progress(wave_solutions[rank], indicators);
+          }
+
+          wave_fingerprints[rank] =
+            utils::solution_fingerprint(wave_solutions[rank]);
+          wave_times[rank] = utils::now() - heuristic_start;
         }
       } catch (...) {
         ep_m.lock();
@@ -134,74 +307,213 @@ protected:
       }
     };
 
-    std::vector<std::thread> heuristics_threads;
+    // Duplicate heuristic solutions are filtered out and replaced with
+    // solutions for further candidates, if any. Solutions with the
+    // same routes assigned to other vehicles are also considered
+    // duplicates.
+    std::set<utils::SolutionIndicators<Route>> unique_indicators;
+    std::unordered_set<uint64_t> unique_fingerprints;
+    bool perturbed = !h_param.empty();
+
+    while (solutions.size() < nb_init_solutions and
+           (solutions.empty() or !cancellation.is_cancelled())) {
+      if (wave_first == candidates.size()) {
+        if (perturbed) {
+          break;
+        }
+        // Slots freed by duplicates go to slightly perturbed variants
+        // of all candidates.
+        const auto variants = heuristics::get_perturbed(candidates);
+        candidates.insert(candidates.end(), variants.begin(), variants.end());
+        perturbed = true;
+        if (wave_first == candidates.size()) {
+          break;
+        }
+      }
 
-    for (const auto& param_ranks : thread_ranks) {
-      if (!param_ranks.empty()) {
-        heuristics_threads.emplace_back(run_heuristics, param_ranks);
+      const std::size_t wave_size =
+        std::min<std::size_t>(nb_init_solutions - solutions.size(),
+                              candidates.size() - wave_first);
+      wave_solutions.assign(wave_size, std::vector<Route>());
+      wave_fingerprints.assign(wave_size, 0);
+      wave_times.assign(wave_size, std::chrono::nanoseconds::zero());
+
+      // Split the heuristic parameters among threads.
+      thread_ranks.assign(nb_threads, std::vector<std::size_t>());
+      for (std::size_t i = 0; i < wave_size; ++i) {
+        thread_ranks[i % nb_threads].push_back(i);
       }
-    }
 
-    for (auto& t : heuristics_threads) {
-      t.join();
+      // Spare threads when there are less heuristics to run than
+      // available threads are used within heuristics supporting it.
+      heuristic_nb_threads =
+        nb_threads / std::min<std::size_t>(nb_threads, wave_size);
+
+      std::vector<std::thread> heuristics_threads;
+
+      for (const auto& param_ranks : thread_ranks) {
+        if (!param_ranks.empty()) {
+          heuristics_threads.emplace_back(run_heuristics, param_ranks);
+        }
+      }
+
+      for (auto& t : heuristics_threads) {
+        t.join();
+      }
+
+      if (ep != nullptr) {
+        std::rethrow_exception(ep);
+      }
+
+      // Registering in candidates order keeps the choice of solutions
+      // independent from threads scheduling.
+      for (std::size_t i = 0; i < wave_size; ++i) {
+        const bool new_fingerprint =
+          unique_fingerprints.insert(wave_fingerprints[i]).second;
+        const bool new_indicators =
+          unique_indicators.emplace(_input, wave_solutions[i]).second;
+        if (new_fingerprint and new_indicators) {
+          solutions.push_back(std::move(wave_solutions[i]));
+        }
+        thread_busy[i % nb_threads] += wave_times[i];
+      }
+
+      wave_first += wave_size;
     }
 
-    if (ep != nullptr) {
-      std::rethrow_exception(ep);
+    const auto heuristics_end = utils::now();
+
+    // Searches use all allocated time, so leave out time spent in
+    // heuristics.
+    Timeout search_timeout;
+    if (timeout.has_value()) {
+      const auto heuristics_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(heuristics_end -
+                                                              solving_start);
+      search_timeout = (heuristics_time <= timeout.value())
+                         ? timeout.value() - heuristics_time
+                         : std::chrono::milliseconds(0);
     }
 
-    // Filter out duplicate heuristics solutions.
-    std::set<utils::SolutionIndicators<Route>> unique_indicators;
-    std::vector<unsigned> to_remove;
-    for (unsigned i = 0; i < solutions.size(); ++i) {
-      const auto result = unique_indicators.emplace(_input, solutions[i]);
-      if (!result.second) {
-        // No insertion means an equivalent solution already exists.
-        to_remove.push_back(i);
+    SolvingStats stats;
+    stats.heuristics = heuristics_end - solving_start;
+
+    // Operators stats and timings are summed across searches.
+    auto set_solving_stats = [&](Solution& sol) {
+      const auto solving_time = utils::now() - solving_start;
+      stats.local_search = solving_time - stats.heuristics;
+      for (const auto busy : thread_busy) {
+        stats.thread_usage.push_back(
+          static_cast<double>(busy.count()) /
+          static_cast<double>(solving_time.count()));
       }
-    }
+      sol.summary.solving_stats = std::move(stats);
+    };
 
-    for (auto remove_rank = to_remove.rbegin(); remove_rank != to_remove.rend();
-         remove_rank++) {
-      solutions.erase(solutions.begin() + *remove_rank);
+    if (_input.get_decomposition_size() != 0 and
+        _input.jobs.size() > _input.get_decomposition_size()) {
+      // Searching the whole instance is too expensive, so the best
+      // heuristic solution is improved on smaller sub-problems
+      // instead.
+      std::vector<utils::SolutionIndicators<Route>> h_indicators;
+      for (const auto& sol : solutions) {
+        h_indicators.emplace_back(_input, sol);
+      }
+      auto& best_sol =
+        solutions[std::distance(h_indicators.cbegin(),
+                                std::min_element(h_indicators.cbegin(),
+                                                 h_indicators.cend()))];
+
+      decomposition::ImprovementCallback<Route> improvement_callback;
+      if (progress) {
+        improvement_callback = report_progress;
+      }
+
+      decomposition::improve(_input,
+                             best_sol,
+                             _input.get_decomposition_size(),
+                             exploration_level,
+                             nb_threads,
+                             search_timeout,
+                             cancellation,
+                             budget,
+                             improvement_callback);
+
+      auto sol = utils::format_solution(_input, best_sol);
+      if (_input.get_solving_stats()) {
+        set_solving_stats(sol);
+      }
+      return sol;
     }
 
     // Split local searches across threads.
     unsigned nb_solutions = solutions.size();
     std::vector<utils::SolutionIndicators<Route>> sol_indicators(nb_solutions);
-#ifdef LOG_LS_OPERATORS
     std::vector<std::array<ls::OperatorStats, OperatorName::MAX>> ls_stats(
       nb_solutions);
-#endif
+    std::vector<std::chrono::nanoseconds> ls_times(nb_solutions);
+    std::vector<std::chrono::nanoseconds> ls_state_updates_times(nb_solutions);
+    std::vector<std::chrono::nanoseconds> ls_job_additions_times(
+      nb_solutions);
+    std::vector<uint64_t> ls_steps(nb_solutions);
+
+    // Genetic search only educates initial solutions here and uses
+    // remaining time or budget afterwards.
+    const bool genetic_search =
+      _input.get_genetic_search() and
+      (search_timeout.has_value() or budget.has_value());
 
-    std::fill(thread_ranks.begin(),
-              thread_ranks.end(),
-              std::vector<std::size_t>());
+    thread_ranks.assign(nb_threads, std::vector<std::size_t>());
     for (std::size_t i = 0; i < nb_solutions; ++i) {
       thread_ranks[i % nb_threads].push_back(i);
     }
 
+    typename LocalSearch::BestSolutionCallback best_sol_callback;
+    if (progress) {
+      best_sol_callback = report_progress;
+    }
+
     auto run_ls = [&](const std::vector<std::size_t>& sol_ranks) {
       try {
-        // Decide time allocated for each search.
+        // Decide time and steps allocated for each search.
         Timeout search_time;
-        if (timeout.has_value()) {
-          search_time = timeout.value() / sol_ranks.size();
+        if (search_timeout.has_value()) {
+          search_time = search_timeout.value() / sol_ranks.size();
+        }
+        Budget search_budget;
+        if (budget.has_value()) {
+          search_budget = budget.value() / sol_ranks.size();
         }
 
         for (auto rank : sol_ranks) {
+          const auto ls_start = utils::now();
+
           // Local search phase.
           LocalSearch ls(_input,
                          solutions[rank],
                          max_nb_jobs_removal,
-                         search_time);
-          ls.run();
+                         search_time,
+                         search_budget,
+                         cancellation,
+                         best_sol_callback);
+          if (_input.has_previous_solution()) {
+            // Jobs from previous solution that could not be kept or
+            // were added since are inserted prior to search.
+            ls.insert_unassigned();
+          }
+          if (genetic_search) {
+            ls.descend();
+          } else {
+            ls.run();
+          }
 
           // Store solution indicators.
           sol_indicators[rank] = ls.indicators();
-#ifdef LOG_LS_OPERATORS
           ls_stats[rank] = ls.get_stats();
-#endif
+          ls_state_updates_times[rank] = ls.get_state_updates_time();
+          ls_job_additions_times[rank] = ls.get_job_additions_time();
+          ls_steps[rank] = ls.get_nb_steps();
+          ls_times[rank] = utils::now() - ls_start;
         }
       } catch (...) {
         ep_m.lock();
@@ -230,13 +542,73 @@ protected:
     utils::log_LS_operators(ls_stats);
 #endif
 
-    auto best_indic =
-      std::min_element(sol_indicators.cbegin(), sol_indicators.cend());
+    std::vector<Route> best_sol;
+    if (genetic_search) {
+      const auto evolve_start = utils::now();
+
+      Timeout evolve_timeout;
+      if (search_timeout.has_value()) {
+        const auto search_time =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            evolve_start - heuristics_end);
+        evolve_timeout = (search_time <= search_timeout.value())
+                           ? search_timeout.value() - search_time
+                           : std::chrono::milliseconds(0);
+      }
+      // Budget applies to each thread, so remove the most steps used
+      // by a thread so far.
+      Budget evolve_budget;
+      if (budget.has_value()) {
+        uint64_t used = 0;
+        for (const auto& sol_ranks : thread_ranks) {
+          uint64_t thread_used = 0;
+          for (const auto rank : sol_ranks) {
+            thread_used += ls_steps[rank];
+          }
+          used = std::max(used, thread_used);
+        }
+        evolve_budget = (used <= budget.value()) ? budget.value() - used : 0;
+      }
+
+      const auto nb_islands = genetic::nb_islands(nb_threads, nb_solutions);
+      best_sol =
+        genetic::evolve<Route, LocalSearch>(_input,
+                                            std::move(solutions),
+                                            max_nb_jobs_removal,
+                                            nb_threads,
+                                            evolve_timeout,
+                                            cancellation,
+                                            evolve_budget,
+                                            best_sol_callback,
+                                            stats);
+
+      const auto evolve_time = utils::now() - evolve_start;
+      for (std::size_t i = 0; i < nb_islands; ++i) {
+        thread_busy[i] += evolve_time;
+      }
+    } else {
+      auto best_indic =
+        std::min_element(sol_indicators.cbegin(), sol_indicators.cend());
+
+      best_sol = std::move(
+        solutions[std::distance(sol_indicators.cbegin(), best_indic)]);
+    }
+
+    auto sol = utils::format_solution(_input, best_sol);
+
+    if (_input.get_solving_stats()) {
+      for (std::size_t rank = 0; rank < nb_solutions; ++rank) {
+        for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+          stats.operators[op] += ls_stats[rank][op];
+        }
+        stats.state_updates += ls_state_updates_times[rank];
+        stats.job_additions += ls_job_additions_times[rank];
+        thread_busy[rank % nb_threads] += ls_times[rank];
+      }
+      set_solving_stats(sol);
+    }
 
-    return utils::format_solution(_input,
-                                  solutions[std::distance(sol_indicators
-                                                            .cbegin(),
-                                                          best_indic)]);
+    return sol;
   }
 
 public:
@@ -244,11 +616,14 @@ public:
 
   virtual ~VRP();
 
-  virtual Solution
-  solve(unsigned exploration_level,
-        unsigned nb_threads,
-        const Timeout& timeout,
-        const std::vector<HeuristicParameters>& h_param) const = 0;
+  virtual Solution solve(unsigned exploration_level,
+                         unsigned nb_threads,
+                         const Timeout& timeout,
+                         const std::vector<HeuristicParameters>& h_param,
+                         const ProgressCallback& progress,
+                         bool progress_with_solution,
+                         const CancellationToken& cancellation,
+                         const Budget& budget) const = 0;
 };
 
 } // namespace vroom
@@ -21,7 +21,7 @@ private:
 public:
   UnassignedExchange(const Input& input,
                      const utils::SolutionState& sol_state,
-                     std::unordered_set<Index>& unassigned,
+                     utils::SparseSet& unassigned,
                      TWRoute& tw_s_route,
                      Index s_vehicle,
                      Index s_rank,
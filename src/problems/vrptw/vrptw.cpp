@@ -141,11 +141,19 @@ VRPTW::VRPTW(const Input& input) : VRP(input) {
 Solution VRPTW::solve(unsigned exploration_level,
                       unsigned nb_threads,
                       const Timeout& timeout,
-                      const std::vector<HeuristicParameters>& h_param) const {
+                      const std::vector<HeuristicParameters>& h_param,
+                      const ProgressCallback& progress,
+                      bool progress_with_solution,
+                      const CancellationToken& cancellation,
+                      const Budget& budget) const {
   return VRP::solve<TWRoute, vrptw::LocalSearch>(exploration_level,
                                                  nb_threads,
                                                  timeout,
                                                  h_param,
+                                                 progress,
+                                                 progress_with_solution,
+                                                 cancellation,
+                                                 budget,
                                                  homogeneous_parameters,
                                                  heterogeneous_parameters);
 }
@@ -23,15 +23,23 @@ using Servers = std::unordered_map<std::string, Server>;
 struct CLArgs {
   // Listing command-line options.
   Servers servers;                           // -a and -p
+  Budget budget;                             // --budget
   bool check;                                // -c
+  std::size_t decomposition_size;            // --decompose
   std::vector<HeuristicParameters> h_params; // -e
+  bool genetic_search;                       // --genetic
   bool geometry;                             // -g
+  bool guided_local_search;                  // --gls
   std::string input_file;                    // -i
   Timeout timeout;                           // -l
   std::string output_file;                   // -o
   ROUTER router;                             // -r
+  bool solving_stats;                        // --stats
   std::string input;                         // cl arg
   unsigned nb_threads;                       // -t
+  std::string previous_solution_file;        // -w
+  std::string progress_file;                 // --progress
+  bool progress_with_solution;               // --progress-solution
   unsigned exploration_level;                // -x
 };
 
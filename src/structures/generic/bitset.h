@@ -0,0 +1,138 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace vroom::utils {
+
+// Fixed-size set of bits stored in 64-bit words so that set
+// operations and iterating over set bits process 64 bits at a time.
+class Bitset {
+private:
+  static constexpr std::size_t WORD_SIZE = 64;
+
+  std::size_t _size;
+  std::vector<uint64_t> _words;
+
+  static unsigned popcount(uint64_t word) {
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    unsigned count = 0;
+    for (; word != 0; word &= word - 1) {
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  // Rank of lowest set bit, word being non-zero.
+  static unsigned lowest_bit(uint64_t word) {
+    assert(word != 0);
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    unsigned rank = 0;
+    for (; (word & 1) == 0; word >>= 1) {
+      ++rank;
+    }
+    return rank;
+#endif
+  }
+
+public:
+  Bitset() : _size(0) {
+  }
+
+  Bitset(std::size_t size, bool value = false)
+    : _size(size),
+      _words((size + WORD_SIZE - 1) / WORD_SIZE,
+             value ? ~static_cast<uint64_t>(0) : 0) {
+    if (value and _size % WORD_SIZE != 0) {
+      // Keep bits past the end unset.
+      _words.back() >>= WORD_SIZE - _size % WORD_SIZE;
+    }
+  }
+
+  std::size_t size() const {
+    return _size;
+  }
+
+  bool test(std::size_t i) const {
+    return (_words[i / WORD_SIZE] >> (i % WORD_SIZE)) & 1;
+  }
+
+  void set(std::size_t i, bool value = true) {
+    assert(i < _size);
+    const auto mask = static_cast<uint64_t>(1) << (i % WORD_SIZE);
+    if (value) {
+      _words[i / WORD_SIZE] |= mask;
+    } else {
+      _words[i / WORD_SIZE] &= ~mask;
+    }
+  }
+
+  std::size_t count() const {
+    std::size_t count = 0;
+    for (const auto word : _words) {
+      count += popcount(word);
+    }
+    return count;
+  }
+
+  bool intersects(const Bitset& other) const {
+    assert(_size == other._size);
+    for (std::size_t w = 0; w < _words.size(); ++w) {
+      if ((_words[w] & other._words[w]) != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool is_subset_of(const Bitset& other) const {
+    assert(_size == other._size);
+    for (std::size_t w = 0; w < _words.size(); ++w) {
+      if ((_words[w] & ~other._words[w]) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Rank of the first set bit starting from i, or size() if there is
+  // none. Iterating over set bits is done using:
+  // for (auto i = b.find_next(0); i < b.size(); i = b.find_next(i + 1))
+  std::size_t find_next(std::size_t i) const {
+    if (i >= _size) {
+      return _size;
+    }
+
+    std::size_t w = i / WORD_SIZE;
+    uint64_t word = _words[w] & (~static_cast<uint64_t>(0) << (i % WORD_SIZE));
+    while (word == 0) {
+      ++w;
+      if (w == _words.size()) {
+        return _size;
+      }
+      word = _words[w];
+    }
+
+    return w * WORD_SIZE + lowest_bit(word);
+  }
+};
+
+} // namespace vroom::utils
+
+#endif
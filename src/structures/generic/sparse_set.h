@@ -0,0 +1,156 @@
+#ifndef SPARSE_SET_H
+#define SPARSE_SET_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <cassert>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "structures/typedefs.h"
+
+namespace vroom::utils {
+
+// Set of indices in [0, size) with constant time lookup. Elements
+// are packed in a vector for contiguous iteration and grouped by
+// bucket, each index belonging to a fixed bucket. Insertion and
+// removal only move one element per bucket following the one
+// involved.
+class SparseSet {
+private:
+  static constexpr std::size_t NOT_IN = std::numeric_limits<std::size_t>::max();
+
+  std::vector<Index> _elements;
+  std::vector<std::size_t> _positions;
+  std::vector<unsigned> _buckets;
+
+  // Elements in bucket b are in [_bucket_ends[b - 1], _bucket_ends[b])
+  // in _elements.
+  std::vector<std::size_t> _bucket_ends;
+
+  void place(Index i, std::size_t rank) {
+    _elements[rank] = i;
+    _positions[i] = rank;
+  }
+
+public:
+  using const_iterator = std::vector<Index>::const_iterator;
+
+  struct Bucket {
+    const_iterator first;
+    const_iterator last;
+
+    const_iterator begin() const {
+      return first;
+    }
+
+    const_iterator end() const {
+      return last;
+    }
+  };
+
+  SparseSet() = default;
+
+  // All indices in a single bucket.
+  SparseSet(std::size_t size)
+    : _positions(size, NOT_IN), _buckets(size, 0), _bucket_ends(1, 0) {
+    _elements.reserve(size);
+  }
+
+  // Index i belongs to bucket buckets[i], with buckets values in [0,
+  // nb_buckets).
+  SparseSet(std::vector<unsigned> buckets, unsigned nb_buckets)
+    : _positions(buckets.size(), NOT_IN),
+      _buckets(std::move(buckets)),
+      _bucket_ends(nb_buckets, 0) {
+    assert(nb_buckets > 0);
+    _elements.reserve(_buckets.size());
+  }
+
+  bool contains(Index i) const {
+    return _positions[i] != NOT_IN;
+  }
+
+  std::size_t size() const {
+    return _elements.size();
+  }
+
+  bool empty() const {
+    return _elements.empty();
+  }
+
+  const_iterator begin() const {
+    return _elements.begin();
+  }
+
+  const_iterator end() const {
+    return _elements.end();
+  }
+
+  std::size_t nb_buckets() const {
+    return _bucket_ends.size();
+  }
+
+  Bucket bucket(unsigned b) const {
+    const auto first = (b == 0) ? 0 : _bucket_ends[b - 1];
+    return {_elements.begin() + first, _elements.begin() + _bucket_ends[b]};
+  }
+
+  void insert(Index i) {
+    if (contains(i)) {
+      return;
+    }
+
+    const auto b = _buckets[i];
+
+    // Make room at the start of each following bucket by moving its
+    // first element to its end.
+    auto hole = _elements.size();
+    _elements.push_back(i);
+    for (auto k = _bucket_ends.size() - 1; k > b; --k) {
+      const auto first = _bucket_ends[k - 1];
+      if (first != hole) {
+        place(_elements[first], hole);
+      }
+      ++_bucket_ends[k];
+      hole = first;
+    }
+
+    place(i, hole);
+    ++_bucket_ends[b];
+  }
+
+  void erase(Index i) {
+    if (!contains(i)) {
+      return;
+    }
+
+    // Fill hole with last element of the same bucket, then move hole
+    // to the end of each following bucket the same way.
+    auto hole = _positions[i];
+    for (auto k = _buckets[i]; k < _bucket_ends.size(); ++k) {
+      const auto last = _bucket_ends[k] - 1;
+      if (last != hole) {
+        place(_elements[last], hole);
+      }
+      --_bucket_ends[k];
+      hole = last;
+    }
+
+    assert(hole == _elements.size() - 1);
+    _elements.pop_back();
+    _positions[i] = NOT_IN;
+  }
+};
+
+} // namespace vroom::utils
+
+#endif
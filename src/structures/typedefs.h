@@ -51,6 +51,9 @@ using Skills = std::unordered_set<Skill>;
 using TimePoint = std::chrono::high_resolution_clock::time_point;
 using Timeout = std::optional<std::chrono::milliseconds>;
 using Deadline = std::optional<TimePoint>;
+// Amount of local search steps allowed. Unlike a timeout, this does
+// not depend on machine load so solving is reproducible.
+using Budget = std::optional<uint64_t>;
 
 // Setting max value would cause trouble with further additions.
 constexpr UserCost INFINITE_USER_COST =
@@ -77,6 +80,41 @@ constexpr unsigned MAX_EXPLORATION_LEVEL = 5;
 constexpr unsigned DEFAULT_EXPLORATION_LEVEL = 5;
 constexpr unsigned DEFAULT_THREADS_NUMBER = 4;
 
+// Shift applied to regret coefficients for perturbed heuristic runs.
+constexpr float REGRET_COEFF_PERTURBATION = 0.15;
+
+// Ruin and recreate parameters: highest number and share of assigned
+// jobs removed at once, noise applied to insertion costs upon
+// recreate and initial record-to-record threshold relative to best
+// cost.
+constexpr unsigned MAX_RUIN_SIZE = 30;
+constexpr double MAX_RUIN_SHARE = 0.2;
+constexpr double RECREATE_NOISE = 0.1;
+constexpr double RECORD_TO_RECORD_THRESHOLD = 0.02;
+
+// Cost of one penalty on an edge in guided local search, relative to
+// average edge cost in solution.
+constexpr double GLS_PENALTY_FACTOR = 0.1;
+
+// Genetic search parameters: population size kept after survivors
+// selection, number of offspring before selection, number of best
+// individuals protected by biased fitness, number of closest
+// individuals used for diversity contribution and number of
+// offspring per island between migrations.
+constexpr std::size_t GENETIC_POPULATION_SIZE = 10;
+constexpr std::size_t GENETIC_GENERATION_SIZE = 10;
+constexpr std::size_t GENETIC_NB_ELITE = 3;
+constexpr std::size_t GENETIC_NB_CLOSE = 3;
+constexpr unsigned GENETIC_MIGRATION_PERIOD = 10;
+
+// Adaptive operator selection is used from that many jobs. Once
+// enough moves have been applied, an operator is skipped if its share
+// of applied moves is below its share of tried moves times
+// ADAPTIVE_OPERATORS_MIN_RATIO.
+constexpr std::size_t ADAPTIVE_OPERATORS_MIN_JOBS = 1000;
+constexpr unsigned ADAPTIVE_OPERATORS_WARMUP = 100;
+constexpr double ADAPTIVE_OPERATORS_MIN_RATIO = 0.2;
+
 // Available routing engines.
 enum class ROUTER { OSRM, LIBOSRM, ORS, VALHALLA };
 
@@ -101,7 +139,14 @@ enum class JOB_TYPE { SINGLE, PICKUP, DELIVERY };
 enum class STEP_TYPE { START, JOB, BREAK, END };
 
 // Heuristic options.
-enum class HEURISTIC { BASIC, DYNAMIC, INIT_ROUTES };
+enum class HEURISTIC {
+  BASIC,
+  DYNAMIC,
+  REGRET,
+  CLUSTERING,
+  INIT_ROUTES,
+  WARM_START
+};
 enum class INIT { NONE, HIGHER_AMOUNT, NEAREST, FURTHEST, EARLIEST_DEADLINE };
 enum class SORT { CAPACITY, COST };
 
@@ -118,13 +163,15 @@ struct HeuristicParameters {
     : heuristic(heuristic), init(init), regret_coeff(regret_coeff), sort(sort) {
   }
 
-  // Only makes sense for user-defined initial routes.
+  // Only makes sense for user-defined initial routes or when
+  // starting from a previous solution.
   constexpr HeuristicParameters(HEURISTIC heuristic)
     : heuristic(heuristic),
       init(INIT::NONE),
       regret_coeff(0),
       sort(SORT::CAPACITY) {
-    assert(heuristic == HEURISTIC::INIT_ROUTES);
+    assert(heuristic == HEURISTIC::INIT_ROUTES or
+           heuristic == HEURISTIC::WARM_START);
   }
 };
 
@@ -176,21 +223,24 @@ inline UserCost scale_to_user_cost(Cost d) {
 }
 } // namespace utils
 
-#ifdef LOG_LS_OPERATORS
 namespace ls {
 struct OperatorStats {
-  unsigned tried_moves;
-  unsigned applied_moves;
-
-  OperatorStats() : tried_moves(0), applied_moves(0) {
-  }
-
-  OperatorStats(const unsigned tried_moves, const unsigned applied_moves)
-    : tried_moves(tried_moves), applied_moves(applied_moves) {
+  uint64_t tried_moves{0};
+  uint64_t applied_moves{0};
+  // Sum of gains for applied moves.
+  Cost gain{0};
+  // Time spent evaluating moves, only measured when required.
+  std::chrono::nanoseconds time{0};
+
+  OperatorStats& operator+=(const OperatorStats& rhs) {
+    tried_moves += rhs.tried_moves;
+    applied_moves += rhs.applied_moves;
+    gain += rhs.gain;
+    time += rhs.time;
+    return *this;
   }
 };
 } // namespace ls
-#endif
 
 } // namespace vroom
 
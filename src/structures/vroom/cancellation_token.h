@@ -0,0 +1,41 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <atomic>
+#include <memory>
+
+namespace vroom {
+
+// Copies share the same state, so a token passed to Input::solve can
+// be cancelled from any other thread holding a copy. Solving then
+// stops as soon as possible and returns the best solution found so
+// far.
+class CancellationToken {
+private:
+  std::shared_ptr<std::atomic<bool>> _cancelled;
+
+public:
+  CancellationToken() : _cancelled(std::make_shared<std::atomic<bool>>(false)) {
+  }
+
+  void cancel() const {
+    _cancelled->store(true);
+  }
+
+  bool is_cancelled() const {
+    return _cancelled->load();
+  }
+};
+
+} // namespace vroom
+
+#endif
@@ -41,6 +41,10 @@ public:
     return discrete_duration_factor;
   }
 
+  Cost get_discrete_cost_factor() const {
+    return discrete_cost_factor;
+  }
+
   bool cost_based_on_duration() const {
     return _cost_based_on_duration;
   }
@@ -7,7 +7,10 @@ All rights reserved (see LICENSE).
 
 */
 
+#include <cmath>
+#include <map>
 #include <mutex>
+#include <numeric>
 #include <thread>
 
 #if USE_LIBOSRM
@@ -44,6 +47,22 @@ void Input::set_geometry(bool geometry) {
   _geometry = geometry;
 }
 
+void Input::set_decomposition_size(std::size_t size) {
+  _decomposition_size = size;
+}
+
+void Input::set_solving_stats(bool solving_stats) {
+  _solving_stats = solving_stats;
+}
+
+void Input::set_guided_local_search(bool guided_local_search) {
+  _guided_local_search = guided_local_search;
+}
+
+void Input::set_genetic_search(bool genetic_search) {
+  _genetic_search = genetic_search;
+}
+
 void Input::add_routing_wrapper(const std::string& profile) {
 #if !USE_ROUTING
   throw RoutingException("VROOM compiled without routing support.");
@@ -174,7 +193,7 @@ void Input::check_job(Job& job) {
     _all_locations_have_coords && job.location.has_coordinates();
 }
 
-void Input::add_job(const Job& job) {
+void Input::add_job(Job job) {
   if (job.type != JOB_TYPE::SINGLE) {
     throw InputException("Wrong job type.");
   }
@@ -182,12 +201,12 @@ void Input::add_job(const Job& job) {
     throw InputException("Duplicate job id: " + std::to_string(job.id) + ".");
   }
   job_id_to_rank[job.id] = jobs.size();
-  jobs.push_back(job);
+  jobs.push_back(std::move(job));
   check_job(jobs.back());
   _has_jobs = true;
 }
 
-void Input::add_shipment(const Job& pickup, const Job& delivery) {
+void Input::add_shipment(Job pickup, Job delivery) {
   if (pickup.priority != delivery.priority) {
     throw InputException("Inconsistent shipment priority for pickup " +
                          std::to_string(pickup.id) + " and delivery " +
@@ -220,7 +239,7 @@ void Input::add_shipment(const Job& pickup, const Job& delivery) {
                          ".");
   }
   pickup_id_to_rank[pickup.id] = jobs.size();
-  jobs.push_back(pickup);
+  jobs.push_back(std::move(pickup));
   check_job(jobs.back());
 
   if (delivery.type != JOB_TYPE::DELIVERY) {
@@ -232,13 +251,13 @@ void Input::add_shipment(const Job& pickup, const Job& delivery) {
       "Duplicate delivery id: " + std::to_string(delivery.id) + ".");
   }
   delivery_id_to_rank[delivery.id] = jobs.size();
-  jobs.push_back(delivery);
+  jobs.push_back(std::move(delivery));
   check_job(jobs.back());
   _has_shipments = true;
 }
 
-void Input::add_vehicle(const Vehicle& vehicle) {
-  vehicles.push_back(vehicle);
+void Input::add_vehicle(Vehicle vehicle) {
+  vehicles.push_back(std::move(vehicle));
 
   auto& current_v = vehicles.back();
 
@@ -251,7 +270,7 @@ void Input::add_vehicle(const Vehicle& vehicle) {
   }
 
   // Check for time-windows and skills.
-  _has_TW = _has_TW || !vehicle.tw.is_default() || !vehicle.breaks.empty();
+  _has_TW = _has_TW || !current_v.tw.is_default() || !current_v.breaks.empty();
   _has_skills = _has_skills || !current_v.skills.empty();
 
   bool has_location_index = false;
@@ -378,19 +397,37 @@ void Input::add_vehicle(const Vehicle& vehicle) {
   _profiles.insert(current_v.profile);
 }
 
+void Input::set_previous_solution(const Solution& solution) {
+  for (const auto& route : solution.routes) {
+    std::vector<VehicleStep> steps;
+    for (const auto& step : route.steps) {
+      if (step.step_type == STEP_TYPE::JOB) {
+        steps.emplace_back(step.job_type, step.id, ForcedService());
+      }
+    }
+    add_previous_route(route.vehicle, std::move(steps));
+  }
+}
+
+void Input::add_previous_route(Id vehicle_id,
+                               std::vector<VehicleStep>&& steps) {
+  _previous_steps.insert_or_assign(vehicle_id, std::move(steps));
+  _has_previous_solution = true;
+}
+
 void Input::set_durations_matrix(const std::string& profile,
                                  Matrix<UserDuration>&& m) {
   if (m.size() == 0) {
     throw InputException("Empty durations matrix for " + profile + " profile.");
   }
-  _durations_matrices.insert_or_assign(profile, m);
+  _durations_matrices.insert_or_assign(profile, std::move(m));
 }
 
 void Input::set_costs_matrix(const std::string& profile, Matrix<UserCost>&& m) {
   if (m.size() == 0) {
     throw InputException("Empty costs matrix for " + profile + " profile.");
   }
-  _costs_matrices.insert_or_assign(profile, m);
+  _costs_matrices.insert_or_assign(profile, std::move(m));
 }
 
 bool Input::is_used_several_times(const Location& location) const {
@@ -402,6 +439,10 @@ bool Input::has_skills() const {
   return _has_skills;
 }
 
+bool Input::has_TW() const {
+  return _has_TW;
+}
+
 bool Input::has_jobs() const {
   return _has_jobs;
 }
@@ -422,21 +463,212 @@ bool Input::has_homogeneous_costs() const {
   return _homogeneous_costs;
 }
 
+Input Input::sub_input(const std::vector<Index>& vehicle_ranks,
+                       const std::vector<Index>& job_ranks) const {
+  Input sub(_servers, _router);
+  sub.set_amount_size(_amount_size);
+
+  // Locations are re-indexed based on their order of appearance so
+  // that matrices only hold the relevant rows and columns.
+  std::vector<Index> matrix_indices;
+  std::unordered_map<Index, Index> matrix_index_to_sub_index;
+  auto sub_location = [&](const Location& location) {
+    auto search = matrix_index_to_sub_index.find(location.index());
+    if (search == matrix_index_to_sub_index.end()) {
+      search = matrix_index_to_sub_index
+                 .emplace(location.index(), matrix_indices.size())
+                 .first;
+      matrix_indices.push_back(location.index());
+    }
+
+    if (location.has_coordinates()) {
+      return Location(search->second, {location.lon(), location.lat()});
+    }
+    return Location(search->second);
+  };
+
+  std::unordered_set<std::string> profiles;
+  for (const auto v : vehicle_ranks) {
+    Vehicle vehicle(vehicles[v]);
+    if (vehicle.has_start()) {
+      vehicle.start = sub_location(vehicle.start.value());
+    }
+    if (vehicle.has_end()) {
+      vehicle.end = sub_location(vehicle.end.value());
+    }
+    vehicle.steps.clear();
+
+    profiles.insert(vehicle.profile);
+    sub.add_vehicle(std::move(vehicle));
+  }
+
+  for (const auto j : job_ranks) {
+    switch (jobs[j].type) {
+    case JOB_TYPE::SINGLE: {
+      Job job(jobs[j]);
+      job.location = sub_location(job.location);
+      sub.add_job(std::move(job));
+      break;
+    }
+    case JOB_TYPE::PICKUP: {
+      assert(static_cast<std::size_t>(j + 1) < jobs.size() and
+             jobs[j + 1].type == JOB_TYPE::DELIVERY);
+      Job pickup(jobs[j]);
+      pickup.location = sub_location(pickup.location);
+      Job delivery(jobs[j + 1]);
+      delivery.location = sub_location(delivery.location);
+      sub.add_shipment(std::move(pickup), std::move(delivery));
+      break;
+    }
+    case JOB_TYPE::DELIVERY:
+      // Added along with matching pickup.
+      break;
+    }
+  }
+
+  for (const auto& profile : profiles) {
+    const auto d_m = _durations_matrices.find(profile);
+    assert(d_m != _durations_matrices.end());
+    sub.set_durations_matrix(profile,
+                             d_m->second.get_sub_matrix(matrix_indices));
+
+    const auto c_m = _costs_matrices.find(profile);
+    if (c_m != _costs_matrices.end()) {
+      sub.set_costs_matrix(profile, c_m->second.get_sub_matrix(matrix_indices));
+    }
+  }
+
+  return sub;
+}
+
+Input Input::penalizable_input() const {
+  std::vector<Index> vehicle_ranks(vehicles.size());
+  std::iota(vehicle_ranks.begin(), vehicle_ranks.end(), 0);
+  std::vector<Index> job_ranks(jobs.size());
+  std::iota(job_ranks.begin(), job_ranks.end(), 0);
+
+  auto penalizable = sub_input(vehicle_ranks, job_ranks);
+  penalizable.set_solving_stats(_solving_stats);
+
+  // Only used from within a solving thread.
+  constexpr unsigned nb_thread = 1;
+  penalizable.set_matrices(nb_thread);
+  penalizable.set_vehicles_costs();
+
+  // Vehicles and jobs ranks are unchanged and vehicles are copied
+  // with their max tasks, so compatibility is copied rather than
+  // computed again.
+  penalizable._vehicle_to_job_compatibility = _vehicle_to_job_compatibility;
+  penalizable._vehicle_to_vehicle_compatibility =
+    _vehicle_to_vehicle_compatibility;
+
+  // Penalties apply to internal costs, so vehicles sharing a matrix
+  // with different cost factors have to read from distinct copies.
+  std::map<std::pair<std::string, Cost>, std::size_t> matrix_ranks;
+  std::vector<std::size_t> vehicle_matrix_ranks;
+  auto& matrices = penalizable._penalizable_costs_matrices;
+  for (const auto& vehicle : penalizable.vehicles) {
+    const auto factor = vehicle.cost_wrapper.get_discrete_cost_factor();
+    const auto [search, inserted] =
+      matrix_ranks.try_emplace({vehicle.profile, factor}, matrices.size());
+    if (inserted) {
+      // Custom costs matrices are only used by vehicles with the
+      // same cost factor, while vehicles without custom costs read
+      // costs from durations matrix.
+      const auto c_m = penalizable._costs_matrices.find(vehicle.profile);
+      if (c_m != penalizable._costs_matrices.end()) {
+        matrices.emplace_back(factor, std::move(c_m->second));
+      } else {
+        const auto d_m = penalizable._durations_matrices.find(vehicle.profile);
+        assert(d_m != penalizable._durations_matrices.end());
+        matrices.emplace_back(factor, d_m->second);
+      }
+    }
+    vehicle_matrix_ranks.push_back(search->second);
+  }
+
+  for (std::size_t v = 0; v < penalizable.vehicles.size(); ++v) {
+    // Keep cost factor based on per-hour value.
+    penalizable.vehicles[v].cost_wrapper.set_costs_matrix(
+      &(matrices[vehicle_matrix_ranks[v]].second));
+  }
+
+  // Profile costs matrices have been moved.
+  penalizable._costs_matrices.clear();
+
+  return penalizable;
+}
+
+void Input::add_edge_penalty(Index i, Index j, Cost penalty) {
+  assert(!_penalizable_costs_matrices.empty());
+
+  UserCost max_user_penalty = 0;
+  for (auto& [factor, matrix] : _penalizable_costs_matrices) {
+    const auto user_penalty =
+      std::max(static_cast<UserCost>(1),
+               static_cast<UserCost>(
+                 std::round(static_cast<double>(penalty) / factor)));
+    matrix[i][j] = utils::add_without_overflow(matrix[i][j], user_penalty);
+    max_user_penalty = std::max(max_user_penalty, user_penalty);
+  }
+
+  // Penalty raises the highest cost from i and to j, which are
+  // accounted for at most once for each job and vehicle in cost
+  // bound (see check_cost_bound).
+  _cost_upper_bound +=
+    utils::scale_from_user_duration(max_user_penalty) *
+    static_cast<Cost>(jobs.size() + 2 * vehicles.size());
+}
+
 bool Input::vehicle_ok_with_vehicle(Index v1_index, Index v2_index) const {
-  return _vehicle_to_vehicle_compatibility[v1_index][v2_index];
+  return _vehicle_to_vehicle_compatibility[v1_index].test(v2_index);
 }
 
-UserCost Input::check_cost_bound(const Matrix<UserCost>& matrix) const {
+UserCost Input::check_cost_bound(const Matrix<UserCost>& matrix,
+                                 unsigned nb_thread) const {
   // Check that we don't have any overflow while computing an upper
   // bound for solution cost.
+  const std::vector<Index> used_index(_matrices_used_index.begin(),
+                                      _matrices_used_index.end());
+
+  // Split lines across threads, each thread computing its own
+  // maximum per column.
+  const auto nb_buckets =
+    std::max(1u,
+             std::min(nb_thread, static_cast<unsigned>(used_index.size())));
 
   std::vector<UserCost> max_cost_per_line(matrix.size(), 0);
-  std::vector<UserCost> max_cost_per_column(matrix.size(), 0);
+  std::vector<std::vector<UserCost>>
+    thread_max_cost_per_column(nb_buckets,
+                               std::vector<UserCost>(matrix.size(), 0));
+
+  auto run_on_lines = [&](unsigned bucket) {
+    auto& max_cost_per_column = thread_max_cost_per_column[bucket];
+    for (std::size_t l = bucket; l < used_index.size(); l += nb_buckets) {
+      const auto i = used_index[l];
+      for (const auto j : used_index) {
+        max_cost_per_line[i] = std::max(max_cost_per_line[i], matrix[i][j]);
+        max_cost_per_column[j] =
+          std::max(max_cost_per_column[j], matrix[i][j]);
+      }
+    }
+  };
 
-  for (const auto i : _matrices_used_index) {
-    for (const auto j : _matrices_used_index) {
-      max_cost_per_line[i] = std::max(max_cost_per_line[i], matrix[i][j]);
-      max_cost_per_column[j] = std::max(max_cost_per_column[j], matrix[i][j]);
+  std::vector<std::thread> bound_threads;
+  for (unsigned bucket = 1; bucket < nb_buckets; ++bucket) {
+    bound_threads.emplace_back(run_on_lines, bucket);
+  }
+  run_on_lines(0);
+
+  for (auto& t : bound_threads) {
+    t.join();
+  }
+
+  auto& max_cost_per_column = thread_max_cost_per_column[0];
+  for (unsigned bucket = 1; bucket < nb_buckets; ++bucket) {
+    for (const auto j : used_index) {
+      max_cost_per_column[j] =
+        std::max(max_cost_per_column[j], thread_max_cost_per_column[bucket][j]);
     }
   }
 
@@ -472,94 +704,162 @@ UserCost Input::check_cost_bound(const Matrix<UserCost>& matrix) const {
   return utils::add_without_overflow(bound, end_bound);
 }
 
-void Input::set_skills_compatibility() {
+void Input::run_on_vehicles(unsigned nb_thread,
+                            const std::function<void(Index)>& f) const {
+  const auto nb_buckets =
+    std::max(1u,
+             std::min(nb_thread, static_cast<unsigned>(vehicles.size())));
+
+  // Each bucket stops at its first failure, so keeping the exception
+  // from the lowest failing vehicle rank makes the reported error
+  // independent from thread scheduling.
+  std::exception_ptr ep = nullptr;
+  std::size_t ep_rank = vehicles.size();
+  std::mutex ep_m;
+
+  auto run_on_bucket = [&](unsigned bucket) {
+    std::size_t v = bucket;
+    try {
+      for (; v < vehicles.size(); v += nb_buckets) {
+        f(v);
+      }
+    } catch (...) {
+      ep_m.lock();
+      if (v < ep_rank) {
+        ep_rank = v;
+        ep = std::current_exception();
+      }
+      ep_m.unlock();
+    }
+  };
+
+  std::vector<std::thread> vehicle_threads;
+  for (unsigned bucket = 1; bucket < nb_buckets; ++bucket) {
+    vehicle_threads.emplace_back(run_on_bucket, bucket);
+  }
+  run_on_bucket(0);
+
+  for (auto& t : vehicle_threads) {
+    t.join();
+  }
+
+  if (ep != nullptr) {
+    std::rethrow_exception(ep);
+  }
+}
+
+void Input::set_skills_compatibility(unsigned nb_thread) {
   // Default to no restriction when no skills are provided.
-  _vehicle_to_job_compatibility = std::vector<
-    std::vector<unsigned char>>(vehicles.size(),
-                                std::vector<unsigned char>(jobs.size(), true));
+  _vehicle_to_job_compatibility =
+    std::vector<utils::Bitset>(vehicles.size(),
+                               utils::Bitset(jobs.size(), true));
   if (_has_skills) {
-    for (std::size_t v = 0; v < vehicles.size(); ++v) {
-      const auto& v_skills = vehicles[v].skills;
+    // Encode skills as dense bitsets so that checking compatibility
+    // for a vehicle/job pair only involves a few word operations.
+    std::unordered_map<Skill, Index> skill_to_rank;
+    auto register_skills = [&](const Skills& skills) {
+      for (const auto s : skills) {
+        skill_to_rank.try_emplace(s, skill_to_rank.size());
+      }
+    };
+    for (const auto& vehicle : vehicles) {
+      register_skills(vehicle.skills);
+    }
+    for (const auto& job : jobs) {
+      register_skills(job.skills);
+    }
 
-      for (std::size_t j = 0; j < jobs.size(); ++j) {
-        bool is_compatible = true;
-        for (const auto& s : jobs[j].skills) {
-          if (v_skills.find(s) == v_skills.end()) {
-            is_compatible = false;
-            break;
-          }
-        }
-        _vehicle_to_job_compatibility[v][j] = is_compatible;
+    auto to_bitset = [&](const Skills& skills) {
+      utils::Bitset b(skill_to_rank.size());
+      for (const auto s : skills) {
+        b.set(skill_to_rank.at(s));
       }
+      return b;
+    };
+
+    std::vector<utils::Bitset> jobs_skills;
+    jobs_skills.reserve(jobs.size());
+    for (const auto& job : jobs) {
+      jobs_skills.push_back(to_bitset(job.skills));
     }
+
+    run_on_vehicles(nb_thread, [&](Index v) {
+      const auto v_skills = to_bitset(vehicles[v].skills);
+
+      for (std::size_t j = 0; j < jobs.size(); ++j) {
+        _vehicle_to_job_compatibility[v].set(j,
+                                             jobs_skills[j].is_subset_of(
+                                               v_skills));
+      }
+    });
   }
 }
 
-void Input::set_extra_compatibility() {
+void Input::set_extra_compatibility(unsigned nb_thread) {
   // Derive potential extra incompatibilities : jobs or shipments with
   // amount that does not fit into vehicle or that cannot be added to
   // an empty route for vehicle based on the timing constraints (when
   // they apply).
-  for (std::size_t v = 0; v < vehicles.size(); ++v) {
+  run_on_vehicles(nb_thread, [&](Index v) {
     TWRoute empty_route(*this, v, _zero.size());
-    for (Index j = 0; j < jobs.size(); ++j) {
-      if (_vehicle_to_job_compatibility[v][j]) {
-        bool is_compatible =
-          empty_route.is_valid_addition_for_capacity(*this,
-                                                     jobs[j].pickup,
-                                                     jobs[j].delivery,
-                                                     0);
-
-        bool is_shipment_pickup = (jobs[j].type == JOB_TYPE::PICKUP);
-
-        if (is_compatible and _has_TW) {
-          if (jobs[j].type == JOB_TYPE::SINGLE) {
-            is_compatible =
-              is_compatible &&
-              empty_route.is_valid_addition_for_tw_without_max_load(*this,
-                                                                    j,
-                                                                    0);
-          } else {
-            assert(is_shipment_pickup);
-            std::vector<Index> p_d({j, static_cast<Index>(j + 1)});
-            is_compatible =
-              is_compatible && empty_route.is_valid_addition_for_tw(*this,
-                                                                    _zero,
-                                                                    p_d.begin(),
-                                                                    p_d.end(),
-                                                                    0,
-                                                                    0);
-          }
+    auto& compatible = _vehicle_to_job_compatibility[v];
+
+    for (auto j = compatible.find_next(0); j < jobs.size();
+         j = compatible.find_next(j + 1)) {
+      bool is_compatible =
+        empty_route.is_valid_addition_for_capacity(*this,
+                                                   jobs[j].pickup,
+                                                   jobs[j].delivery,
+                                                   0);
+
+      bool is_shipment_pickup = (jobs[j].type == JOB_TYPE::PICKUP);
+
+      if (is_compatible and _has_TW) {
+        if (jobs[j].type == JOB_TYPE::SINGLE) {
+          is_compatible =
+            is_compatible &&
+            empty_route.is_valid_addition_for_tw_without_max_load(*this,
+                                                                  j,
+                                                                  0);
+        } else {
+          assert(is_shipment_pickup);
+          std::vector<Index> p_d({static_cast<Index>(j),
+                                  static_cast<Index>(j + 1)});
+          is_compatible =
+            is_compatible && empty_route.is_valid_addition_for_tw(*this,
+                                                                  _zero,
+                                                                  p_d.begin(),
+                                                                  p_d.end(),
+                                                                  0,
+                                                                  0);
         }
+      }
 
-        _vehicle_to_job_compatibility[v][j] = is_compatible;
-        if (is_shipment_pickup) {
-          // Skipping matching delivery which is next in line in jobs.
-          _vehicle_to_job_compatibility[v][j + 1] = is_compatible;
-          ++j;
-        }
+      compatible.set(j, is_compatible);
+      if (is_shipment_pickup) {
+        // Skipping matching delivery which is next in line in jobs.
+        compatible.set(j + 1, is_compatible);
+        ++j;
       }
     }
-  }
+  });
 }
 
-void Input::set_vehicles_compatibility() {
+void Input::set_vehicles_compatibility(unsigned nb_thread) {
   _vehicle_to_vehicle_compatibility =
-    std::vector<std::vector<bool>>(vehicles.size(),
-                                   std::vector<bool>(vehicles.size(), false));
-  for (std::size_t v1 = 0; v1 < vehicles.size(); ++v1) {
-    _vehicle_to_vehicle_compatibility[v1][v1] = true;
-    for (std::size_t v2 = v1 + 1; v2 < vehicles.size(); ++v2) {
-      for (std::size_t j = 0; j < jobs.size(); ++j) {
-        if (_vehicle_to_job_compatibility[v1][j] and
-            _vehicle_to_job_compatibility[v2][j]) {
-          _vehicle_to_vehicle_compatibility[v1][v2] = true;
-          _vehicle_to_vehicle_compatibility[v2][v1] = true;
-          break;
-        }
+    std::vector<utils::Bitset>(vehicles.size(),
+                               utils::Bitset(vehicles.size()));
+
+  run_on_vehicles(nb_thread, [&](Index v1) {
+    auto& compatible = _vehicle_to_vehicle_compatibility[v1];
+    compatible.set(v1);
+    for (std::size_t v2 = 0; v2 < vehicles.size(); ++v2) {
+      if (v2 != v1 and _vehicle_to_job_compatibility[v1].intersects(
+                         _vehicle_to_job_compatibility[v2])) {
+        compatible.set(v2);
       }
     }
-  }
+  });
 }
 
 void Input::set_vehicles_costs() {
@@ -589,7 +889,7 @@ void Input::set_vehicles_costs() {
   }
 }
 
-void Input::set_vehicles_max_tasks() {
+void Input::set_vehicles_max_tasks(unsigned nb_thread) {
   if (_has_jobs and !_has_shipments and _amount_size > 0) {
     // For job-only instances where capacity restrictions apply:
     // compute an upper bound of the number of jobs for each vehicle
@@ -624,7 +924,7 @@ void Input::set_vehicles_max_tasks() {
                 job_deliveries_per_component[i].end());
     }
 
-    for (Index v = 0; v < vehicles.size(); ++v) {
+    run_on_vehicles(nb_thread, [&](Index v) {
       std::size_t max_tasks = jobs.size();
 
       for (std::size_t i = 0; i < _amount_size; ++i) {
@@ -652,7 +952,7 @@ void Input::set_vehicles_max_tasks() {
       }
 
       vehicles[v].max_tasks = std::min(vehicles[v].max_tasks, max_tasks);
-    }
+    });
   }
 
   if (_has_TW) {
@@ -676,12 +976,12 @@ void Input::set_vehicles_max_tasks() {
     }
     std::sort(job_times.begin(), job_times.end());
 
-    for (Index v = 0; v < vehicles.size(); ++v) {
+    run_on_vehicles(nb_thread, [&](Index v) {
       auto& vehicle = vehicles[v];
 
       if (vehicle.tw.is_default()) {
         // No restriction will apply.
-        continue;
+        return;
       }
 
       const auto vehicle_duration = vehicle.available_duration();
@@ -699,7 +999,7 @@ void Input::set_vehicles_max_tasks() {
       }
 
       vehicle.max_tasks = std::min(vehicle.max_tasks, doable_tasks);
-    }
+    });
   }
 }
 
@@ -784,6 +1084,38 @@ void Input::set_vehicle_steps_ranks() {
   }
 }
 
+void Input::set_previous_routes_ranks() {
+  // Unlike user-defined steps, previous routes may refer to jobs that
+  // are no longer part of the problem: those are simply ignored.
+  _previous_routes.assign(vehicles.size(), std::vector<Index>());
+  std::unordered_set<Index> planned_ranks;
+
+  for (Index v = 0; v < vehicles.size(); ++v) {
+    auto search = _previous_steps.find(vehicles[v].id);
+    if (search == _previous_steps.end()) {
+      continue;
+    }
+
+    for (const auto& step : search->second) {
+      if (step.type != STEP_TYPE::JOB) {
+        continue;
+      }
+
+      const auto& id_to_rank = (step.job_type == JOB_TYPE::SINGLE)
+                                 ? job_id_to_rank
+                               : (step.job_type == JOB_TYPE::PICKUP)
+                                 ? pickup_id_to_rank
+                                 : delivery_id_to_rank;
+
+      auto rank = id_to_rank.find(step.id);
+      if (rank != id_to_rank.end() and
+          planned_ranks.insert(rank->second).second) {
+        _previous_routes[v].push_back(rank->second);
+      }
+    }
+  }
+}
+
 void Input::set_matrices(unsigned nb_thread) {
   if ((!_durations_matrices.empty() or !_costs_matrices.empty()) and
       !_has_custom_location_index) {
@@ -822,6 +1154,9 @@ void Input::set_matrices(unsigned nb_thread) {
     }
   }
 
+  // Spare threads are used to check cost bounds.
+  const unsigned profile_nb_thread = nb_thread / nb_buckets;
+
   std::exception_ptr ep = nullptr;
   std::mutex ep_m;
   std::mutex cost_bound_m;
@@ -880,7 +1215,8 @@ void Input::set_matrices(unsigned nb_thread) {
           }
 
           // Check for potential overflow in solution cost.
-          const UserCost current_bound = check_cost_bound(c_m->second);
+          const UserCost current_bound =
+            check_cost_bound(c_m->second, profile_nb_thread);
           cost_bound_m.lock();
           _cost_upper_bound =
             std::max(_cost_upper_bound,
@@ -888,7 +1224,8 @@ void Input::set_matrices(unsigned nb_thread) {
           cost_bound_m.unlock();
         } else {
           // Durations matrix will be used for costs.
-          const UserCost current_bound = check_cost_bound(d_m->second);
+          const UserCost current_bound =
+            check_cost_bound(d_m->second, profile_nb_thread);
           cost_bound_m.lock();
           _cost_upper_bound =
             std::max(_cost_upper_bound,
@@ -930,28 +1267,48 @@ std::unique_ptr<VRP> Input::get_problem() const {
 Solution Input::solve(unsigned exploration_level,
                       unsigned nb_thread,
                       const Timeout& timeout,
-                      const std::vector<HeuristicParameters>& h_param) {
+                      const std::vector<HeuristicParameters>& h_param,
+                      const ProgressCallback& progress,
+                      bool progress_with_solution,
+                      const CancellationToken& cancellation,
+                      const Budget& budget) {
   if (_geometry and !_all_locations_have_coords) {
     // Early abort when info is required with missing coordinates.
     throw InputException("Route geometry request with missing coordinates.");
   }
 
+  if (_has_initial_routes and _has_previous_solution) {
+    // Both would provide a starting point, with no sensible way to
+    // merge them.
+    throw InputException("Vehicle steps can't be used with a warm start.");
+  }
+
   if (_has_initial_routes) {
     set_vehicle_steps_ranks();
   }
 
+  if (_has_previous_solution) {
+    set_previous_routes_ranks();
+  }
+
   set_matrices(nb_thread);
   set_vehicles_costs();
 
+  const auto start_preprocessing = utils::now();
+
   // Fill vehicle/job compatibility matrices.
-  set_skills_compatibility();
-  set_extra_compatibility();
-  set_vehicles_compatibility();
+  set_skills_compatibility(nb_thread);
+  set_extra_compatibility(nb_thread);
+  set_vehicles_compatibility(nb_thread);
 
   // Add implicit max_tasks constraints derived from capacity and
   // TW. Note: rely on set_extra_compatibility being run previously to
   // catch wrong breaks definition.
-  set_vehicles_max_tasks();
+  set_vehicles_max_tasks(nb_thread);
+
+  const auto preprocessing =
+    std::chrono::duration_cast<std::chrono::milliseconds>(utils::now() -
+                                                          start_preprocessing);
 
   // Load relevant problem.
   auto instance = get_problem();
@@ -971,13 +1328,23 @@ Solution Input::solve(unsigned exploration_level,
   // Solve.
   const std::vector<HeuristicParameters> h_init_routes(1,
                                                        HEURISTIC::INIT_ROUTES);
+  const std::vector<HeuristicParameters> h_warm_start(1,
+                                                      HEURISTIC::WARM_START);
+  const auto& parameters = (_has_previous_solution) ? h_warm_start
+                           : (_has_initial_routes)  ? h_init_routes
+                                                    : h_param;
   auto sol = instance->solve(exploration_level,
                              nb_thread,
                              solve_time,
-                             (_has_initial_routes) ? h_init_routes : h_param);
+                             parameters,
+                             progress,
+                             progress_with_solution,
+                             cancellation,
+                             budget);
 
   // Update timing info.
   sol.summary.computing_times.loading = loading.count();
+  sol.summary.computing_times.preprocessing = preprocessing.count();
 
   _end_solving = std::chrono::high_resolution_clock::now();
   sol.summary.computing_times.solving =
@@ -1026,7 +1393,11 @@ Solution Input::check(unsigned nb_thread) {
   set_vehicles_costs();
 
   // Fill basic skills compatibility matrix.
-  set_skills_compatibility();
+  const auto start_preprocessing = utils::now();
+  set_skills_compatibility(nb_thread);
+  const auto preprocessing =
+    std::chrono::duration_cast<std::chrono::milliseconds>(utils::now() -
+                                                          start_preprocessing);
 
   _end_loading = std::chrono::high_resolution_clock::now();
 
@@ -1039,6 +1410,7 @@ Solution Input::check(unsigned nb_thread) {
 
   // Update timing info.
   sol.summary.computing_times.loading = loading;
+  sol.summary.computing_times.preprocessing = preprocessing.count();
 
   _end_solving = std::chrono::high_resolution_clock::now();
   sol.summary.computing_times.solving =
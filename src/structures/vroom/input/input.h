@@ -11,12 +11,16 @@ All rights reserved (see LICENSE).
 */
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <unordered_map>
 
 #include "routing/wrapper.h"
+#include "structures/generic/bitset.h"
 #include "structures/generic/matrix.h"
 #include "structures/typedefs.h"
+#include "structures/vroom/cancellation_token.h"
+#include "structures/vroom/solution/progress.h"
 #include "structures/vroom/solution/solution.h"
 #include "structures/vroom/vehicle.h"
 
@@ -43,20 +47,31 @@ private:
   bool _has_all_coordinates{true};
   bool _has_custom_location_index;
   bool _has_initial_routes{false};
+  bool _has_previous_solution{false};
   bool _homogeneous_locations{true};
   bool _homogeneous_profiles{true};
   bool _homogeneous_costs{true};
   bool _geometry{false};
+  std::size_t _decomposition_size{0};
+  bool _solving_stats{false};
+  bool _guided_local_search{false};
+  bool _genetic_search{false};
   bool _has_jobs{false};
   bool _has_shipments{false};
   std::unordered_map<std::string, Matrix<UserDuration>> _durations_matrices;
   std::unordered_map<std::string, Matrix<UserCost>> _costs_matrices;
+  // Only set for instances built using penalizable_input: costs
+  // matrices owned by the instance, one for each group of vehicles
+  // sharing a profile and a cost factor, along with that factor.
+  std::vector<std::pair<Cost, Matrix<UserCost>>> _penalizable_costs_matrices;
   Cost _cost_upper_bound{0};
   std::vector<Location> _locations;
   std::unordered_map<Location, Index> _locations_to_index;
   std::unordered_set<Location> _locations_used_several_times;
-  std::vector<std::vector<unsigned char>> _vehicle_to_job_compatibility;
-  std::vector<std::vector<bool>> _vehicle_to_vehicle_compatibility;
+  std::vector<utils::Bitset> _vehicle_to_job_compatibility;
+  std::vector<utils::Bitset> _vehicle_to_vehicle_compatibility;
+  std::unordered_map<Id, std::vector<VehicleStep>> _previous_steps;
+  std::vector<std::vector<Index>> _previous_routes;
   std::unordered_set<Index> _matrices_used_index;
   Index _max_matrices_used_index{0};
   bool _all_locations_have_coords{true};
@@ -71,14 +86,21 @@ private:
 
   void check_job(Job& job);
 
-  UserCost check_cost_bound(const Matrix<UserCost>& matrix) const;
+  UserCost check_cost_bound(const Matrix<UserCost>& matrix,
+                            unsigned nb_thread) const;
 
-  void set_skills_compatibility();
-  void set_extra_compatibility();
-  void set_vehicles_compatibility();
+  // Run f for all vehicle ranks, splitting vehicles across nb_thread
+  // threads.
+  void run_on_vehicles(unsigned nb_thread,
+                       const std::function<void(Index)>& f) const;
+
+  void set_skills_compatibility(unsigned nb_thread);
+  void set_extra_compatibility(unsigned nb_thread);
+  void set_vehicles_compatibility(unsigned nb_thread);
   void set_vehicles_costs();
-  void set_vehicles_max_tasks();
+  void set_vehicles_max_tasks(unsigned nb_thread);
   void set_vehicle_steps_ranks();
+  void set_previous_routes_ranks();
   void set_matrices(unsigned nb_thread);
 
   void add_routing_wrapper(const std::string& profile);
@@ -102,11 +124,53 @@ public:
 
   void set_geometry(bool geometry);
 
-  void add_job(const Job& job);
+  // Solve instances with more than size jobs by improving routes on
+  // sub-problems of around size jobs. A zero size means the whole
+  // instance is always searched at once.
+  void set_decomposition_size(std::size_t size);
+
+  std::size_t get_decomposition_size() const {
+    return _decomposition_size;
+  }
+
+  // Report operators stats, phases timings and threads usage in
+  // solution summary.
+  void set_solving_stats(bool solving_stats);
+
+  bool get_solving_stats() const {
+    return _solving_stats;
+  }
+
+  // Once local search gets stuck, use remaining time or budget for
+  // guided local search instead of ruin and recreate.
+  void set_guided_local_search(bool guided_local_search);
+
+  bool get_guided_local_search() const {
+    return _guided_local_search;
+  }
+
+  // Use time or budget left once initial solutions are searched to
+  // evolve a population of solutions, instead of searching each of
+  // them further on its own.
+  void set_genetic_search(bool genetic_search);
+
+  bool get_genetic_search() const {
+    return _genetic_search;
+  }
 
-  void add_shipment(const Job& pickup, const Job& delivery);
+  void add_job(Job job);
 
-  void add_vehicle(const Vehicle& vehicle);
+  void add_shipment(Job pickup, Job delivery);
+
+  void add_vehicle(Vehicle vehicle);
+
+  // Use routes from a previous solution as a starting point when
+  // solving. Vehicles and jobs are matched based on their ids and
+  // previous routes are repaired to match current input. Solving
+  // throws if any vehicle also has user-defined steps.
+  void set_previous_solution(const Solution& solution);
+
+  void add_previous_route(Id vehicle_id, std::vector<VehicleStep>&& steps);
 
   void set_durations_matrix(const std::string& profile,
                             Matrix<UserDuration>&& m);
@@ -120,6 +184,8 @@ public:
 
   bool has_skills() const;
 
+  bool has_TW() const;
+
   bool has_jobs() const;
 
   bool has_shipments() const;
@@ -128,24 +194,70 @@ public:
     return _cost_upper_bound;
   }
 
+  bool has_previous_solution() const {
+    return _has_previous_solution;
+  }
+
+  // Job ranks from previous route for vehicle at rank v, only valid
+  // once solving has started.
+  const std::vector<Index>& get_previous_route(Index v) const {
+    return _previous_routes[v];
+  }
+
   bool has_homogeneous_locations() const;
 
   bool has_homogeneous_profiles() const;
 
   bool has_homogeneous_costs() const;
 
+  // Build a new instance with vehicles and jobs at given ranks, using
+  // the relevant parts of matrices. Only valid once solving has
+  // started. Job ranks have to include matching deliveries for
+  // pickups.
+  Input sub_input(const std::vector<Index>& vehicle_ranks,
+                  const std::vector<Index>& job_ranks) const;
+
+  // Build a ready-to-search copy of this instance where all vehicles
+  // read costs from a matrix owned by the copy, so that travel costs
+  // can be penalized using add_edge_penalty. Vehicles and jobs ranks
+  // are unchanged but locations are re-indexed. Only valid once
+  // solving has started.
+  Input penalizable_input() const;
+
+  // Add penalty to travel costs from location with matrix index i to
+  // location with matrix index j, for all vehicles. Penalty is
+  // rounded to the closest positive value matching each vehicle cost
+  // factor. Only valid on an instance built using
+  // penalizable_input.
+  void add_edge_penalty(Index i, Index j, Cost penalty);
+
   bool vehicle_ok_with_job(size_t v_index, size_t j_index) const {
-    return static_cast<bool>(_vehicle_to_job_compatibility[v_index][j_index]);
+    return _vehicle_to_job_compatibility[v_index].test(j_index);
+  }
+
+  // Ranks of jobs compatible with vehicle as set bits.
+  const utils::Bitset& compatible_jobs(Index v_index) const {
+    return _vehicle_to_job_compatibility[v_index];
   }
 
   // Returns true iff both vehicles have common job candidates.
   bool vehicle_ok_with_vehicle(Index v1_index, Index v2_index) const;
 
+  // If provided, progress is called each time a better solution is
+  // found while solving. Calls may come from several threads but
+  // never overlap. Single-vehicle problems solved as a TSP only
+  // report their final solution. Setting a budget without a timeout
+  // provides identical solutions across runs for a given number of
+  // threads.
   Solution solve(unsigned exploration_level,
                  unsigned nb_thread,
                  const Timeout& timeout = Timeout(),
                  const std::vector<HeuristicParameters>& h_param =
-                   std::vector<HeuristicParameters>());
+                   std::vector<HeuristicParameters>(),
+                 const ProgressCallback& progress = ProgressCallback(),
+                 bool progress_with_solution = false,
+                 const CancellationToken& cancellation = CancellationToken(),
+                 const Budget& budget = Budget());
 
   Solution check(unsigned nb_thread);
 };
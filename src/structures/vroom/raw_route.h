@@ -157,6 +157,11 @@ public:
     return _current_loads[s];
   }
 
+  std::pair<Index, Index> tw_insertion_ranks(const Input&,
+                                             const Index) const {
+    return {0, route.size() + 1};
+  };
+
   bool is_valid_addition_for_tw(const Input&, const Index, const Index) const {
     return true;
   };
@@ -17,6 +17,8 @@ namespace vroom {
 struct ComputingTimes {
   // Computing times in milliseconds.
   UserDuration loading{0};
+  // Part of loading spent on compatibility and max_tasks checks.
+  UserDuration preprocessing{0};
   UserDuration solving{0};
   UserDuration routing{0};
 
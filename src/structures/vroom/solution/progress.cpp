@@ -0,0 +1,30 @@
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include "structures/vroom/solution/progress.h"
+
+namespace vroom {
+
+Progress::Progress(UserDuration solving,
+                   Priority priority,
+                   unsigned assigned,
+                   unsigned unassigned,
+                   UserCost cost,
+                   UserDuration duration,
+                   unsigned routes)
+  : solving(solving),
+    priority(priority),
+    assigned(assigned),
+    unassigned(unassigned),
+    cost(cost),
+    duration(duration),
+    routes(routes) {
+}
+
+} // namespace vroom
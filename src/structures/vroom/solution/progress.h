@@ -0,0 +1,49 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include <functional>
+#include <optional>
+
+#include "structures/typedefs.h"
+#include "structures/vroom/solution/solution.h"
+
+namespace vroom {
+
+// Describes the best solution found so far while solving.
+struct Progress {
+  // Time spent solving so far in milliseconds.
+  const UserDuration solving;
+  const Priority priority;
+  const unsigned assigned;
+  const unsigned unassigned;
+  const UserCost cost;
+  const UserDuration duration;
+  const unsigned routes;
+
+  // Only set if the formatted solution is requested along with
+  // progress.
+  std::optional<Solution> solution;
+
+  Progress(UserDuration solving,
+           Priority priority,
+           unsigned assigned,
+           unsigned unassigned,
+           UserCost cost,
+           UserDuration duration,
+           unsigned routes);
+};
+
+using ProgressCallback = std::function<void(const Progress&)>;
+
+} // namespace vroom
+
+#endif
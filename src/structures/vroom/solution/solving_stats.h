@@ -0,0 +1,37 @@
+#ifndef SOLVING_STATS_H
+#define SOLVING_STATS_H
+
+/*
+
+This file is part of VROOM.
+
+Copyright (c) 2015-2022, Julien Coupey.
+All rights reserved (see LICENSE).
+
+*/
+
+#include "structures/typedefs.h"
+
+namespace vroom {
+
+struct SolvingStats {
+  // Local search operators stats summed across all searches.
+  std::array<ls::OperatorStats, OperatorName::MAX> operators;
+
+  // Wall-clock time spent in heuristics and local search phases.
+  std::chrono::nanoseconds heuristics{0};
+  std::chrono::nanoseconds local_search{0};
+
+  // Time spent within local search on solution state updates and job
+  // additions, summed across all searches.
+  std::chrono::nanoseconds state_updates{0};
+  std::chrono::nanoseconds job_additions{0};
+
+  // Share of heuristics and local search wall-clock time spent
+  // working, for each thread.
+  std::vector<double> thread_usage;
+};
+
+} // namespace vroom
+
+#endif
@@ -13,6 +13,7 @@ All rights reserved (see LICENSE).
 #include "structures/typedefs.h"
 #include "structures/vroom/amount.h"
 #include "structures/vroom/solution/computing_times.h"
+#include "structures/vroom/solution/solving_stats.h"
 #include "structures/vroom/solution/violations.h"
 
 namespace vroom {
@@ -31,6 +32,8 @@ struct Summary {
   UserDuration waiting_time;
   Distance distance;
   ComputingTimes computing_times;
+  // Only set when requested using Input::set_solving_stats.
+  std::optional<SolvingStats> solving_stats;
 
   Violations violations;
 
@@ -12,9 +12,35 @@ All rights reserved (see LICENSE).
 
 namespace vroom::utils {
 
+// One bucket per distinct job priority, higher priorities first.
+static SparseSet priority_buckets(const Input& input) {
+  std::vector<Priority> priorities;
+  priorities.reserve(input.jobs.size());
+  for (const auto& job : input.jobs) {
+    priorities.push_back(job.priority);
+  }
+  std::sort(priorities.begin(), priorities.end(), std::greater<Priority>());
+  priorities.erase(std::unique(priorities.begin(), priorities.end()),
+                   priorities.end());
+
+  std::vector<unsigned> buckets;
+  buckets.reserve(input.jobs.size());
+  for (const auto& job : input.jobs) {
+    const auto priority_rank = std::lower_bound(priorities.begin(),
+                                                priorities.end(),
+                                                job.priority,
+                                                std::greater<Priority>());
+    buckets.push_back(std::distance(priorities.begin(), priority_rank));
+  }
+
+  const auto nb_buckets = std::max<std::size_t>(priorities.size(), 1);
+  return SparseSet(std::move(buckets), nb_buckets);
+}
+
 SolutionState::SolutionState(const Input& input)
   : _input(input),
     _nb_vehicles(_input.vehicles.size()),
+    unassigned(priority_buckets(_input)),
     fwd_costs(_nb_vehicles, std::vector<std::vector<Eval>>(_nb_vehicles)),
     bwd_costs(_nb_vehicles, std::vector<std::vector<Eval>>(_nb_vehicles)),
     fwd_skill_rank(_nb_vehicles, std::vector<Index>(_nb_vehicles)),
@@ -58,14 +84,18 @@ template <class Solution> void SolutionState::setup(const Solution& sol) {
   }
 
   // Initialize unassigned jobs.
-  Index x = 0;
-  std::generate_n(std::inserter(unassigned, unassigned.end()),
-                  _input.jobs.size(),
-                  [&] { return x++; });
-
+  std::vector<bool> assigned(_input.jobs.size(), false);
   for (const auto& r : sol) {
     for (const auto i : r.route) {
-      unassigned.erase(i);
+      assigned[i] = true;
+    }
+  }
+
+  for (Index j = 0; j < _input.jobs.size(); ++j) {
+    if (assigned[j]) {
+      unassigned.erase(j);
+    } else {
+      unassigned.insert(j);
     }
   }
 }
@@ -497,11 +527,13 @@ void SolutionState::set_insertion_ranks(const TWRoute& tw_r, Index v) {
 
   const auto& vehicle = _input.vehicles[v];
 
-  for (std::size_t j = 0; j < _input.jobs.size(); ++j) {
-    if (!_input.vehicle_ok_with_job(v, j)) {
-      insertion_ranks_end[v][j] = 0;
-      continue;
-    }
+  // Only compatible jobs can be inserted at all.
+  std::fill(insertion_ranks_end[v].begin(), insertion_ranks_end[v].end(), 0);
+  const auto& compatible = _input.compatible_jobs(v);
+
+  for (auto j = compatible.find_next(0); j < _input.jobs.size();
+       j = compatible.find_next(j + 1)) {
+    insertion_ranks_end[v][j] = tw_r.route.size() + 1;
 
     const auto& job = _input.jobs[j];
 
@@ -613,6 +645,8 @@ void SolutionState::update_route_eval(const std::vector<Index>& route,
   route_evals[v] = route_eval_for_vehicle(_input, v, route);
 }
 
+template void SolutionState::setup(const RawRoute&, Index);
+template void SolutionState::setup(const TWRoute&, Index);
 template void SolutionState::setup(const std::vector<RawRoute>&);
 template void SolutionState::setup(const std::vector<TWRoute>&);
 
@@ -10,6 +10,7 @@ All rights reserved (see LICENSE).
 
 */
 
+#include "structures/generic/sparse_set.h"
 #include "structures/typedefs.h"
 #include "structures/vroom/input/input.h"
 #include "structures/vroom/tw_route.h"
@@ -22,8 +23,8 @@ private:
   const std::size_t _nb_vehicles;
 
 public:
-  // Store unassigned jobs.
-  std::unordered_set<Index> unassigned;
+  // Store unassigned jobs, bucketed by decreasing priority.
+  SparseSet unassigned;
 
   // fwd_costs[v][new_v][i] stores the total cost from job at rank 0
   // to job at rank i in the route for vehicle v, from the point of
@@ -716,6 +716,33 @@ OrderChoice TWRoute::order_choice(const Input& input,
   return oc;
 }
 
+std::pair<Index, Index>
+TWRoute::tw_insertion_ranks(const Input& input, const Index job_rank) const {
+  const auto& job = input.jobs[job_rank];
+  const auto job_available = job.tws.front().start;
+  const auto job_deadline = job.tws.back().end;
+
+  if (job_deadline < v_start or v_end < job_available) {
+    return {0, 0};
+  }
+
+  // Job has to be done before latest date of next task.
+  const auto first = std::distance(latest.begin(),
+                                   std::lower_bound(latest.begin(),
+                                                    latest.end(),
+                                                    job_available +
+                                                      job.service));
+
+  // Previous task has to start before job deadline.
+  const auto last = std::distance(earliest.begin(),
+                                  std::upper_bound(earliest.begin(),
+                                                   earliest.end(),
+                                                   job_deadline)) +
+                    1;
+
+  return {first, last};
+}
+
 template <class InputIterator>
 bool TWRoute::is_valid_addition_for_tw(const Input& input,
                                        const Amount& delivery,
@@ -140,6 +140,14 @@ public:
     return route.size();
   }
 
+  // Ranks range [first, last) outside of which adding job at
+  // job_rank is bound to violate its time windows, only based on
+  // earliest and latest dates in route. As those dates are
+  // non-decreasing along the route, the range is found using binary
+  // searches.
+  std::pair<Index, Index> tw_insertion_ranks(const Input& input,
+                                             const Index job_rank) const;
+
   // Check validity for addition of job at job_rank in current route
   // at rank.
   bool is_valid_addition_for_tw(const Input& input,
@@ -81,7 +81,6 @@ inline SORT get_sort(const std::string& s) {
   throw InputException("Invalid heuristic parameter in command-line.");
 }
 
-#ifdef LOG_LS_OPERATORS
 const std::array<std::string, OperatorName::MAX>
   operator_names({"UnassignedExchange",
                   "CrossExchange",
@@ -101,19 +100,20 @@ const std::array<std::string, OperatorName::MAX>
                   "SwapStar",
                   "RouteSplit"});
 
+#ifdef LOG_LS_OPERATORS
 inline void log_LS_operators(
   const std::vector<std::array<ls::OperatorStats, OperatorName::MAX>>&
     ls_stats) {
   assert(!ls_stats.empty());
 
   // Sum indicators per operator.
-  std::array<unsigned, OperatorName::MAX> tried_sums;
-  std::array<unsigned, OperatorName::MAX> applied_sums;
+  std::array<uint64_t, OperatorName::MAX> tried_sums;
+  std::array<uint64_t, OperatorName::MAX> applied_sums;
   tried_sums.fill(0);
   applied_sums.fill(0);
 
-  unsigned total_tried = 0;
-  unsigned total_applied = 0;
+  uint64_t total_tried = 0;
+  uint64_t total_applied = 0;
   for (const auto& ls_run : ls_stats) {
     for (auto op = 0; op < OperatorName::MAX; ++op) {
       tried_sums[op] += ls_run[op].tried_moves;
@@ -152,7 +152,7 @@ inline HeuristicParameters str_to_heuristic_param(const std::string& s) {
   try {
     auto h = std::stoul(tokens[0]);
 
-    if (h != 0 and h != 1) {
+    if (h > 3) {
       throw InputException("Invalid heuristic parameter in command-line.");
     }
 
@@ -363,6 +363,34 @@ inline Eval route_eval_for_vehicle(const Input& input,
                                 route.end());
 }
 
+inline void hash_combine(uint64_t& seed, uint64_t value) {
+  seed ^= value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+}
+
+// Hash of the job sequences in a solution, regardless of the vehicles
+// they are assigned to. Solutions only differing by a permutation of
+// routes across vehicles share the same fingerprint.
+template <class Route>
+uint64_t solution_fingerprint(const std::vector<Route>& sol) {
+  std::vector<uint64_t> route_hashes;
+  for (const auto& r : sol) {
+    if (!r.empty()) {
+      uint64_t route_hash = r.route.size();
+      for (const auto job_rank : r.route) {
+        hash_combine(route_hash, job_rank);
+      }
+      route_hashes.push_back(route_hash);
+    }
+  }
+  std::sort(route_hashes.begin(), route_hashes.end());
+
+  uint64_t fingerprint = route_hashes.size();
+  for (const auto route_hash : route_hashes) {
+    hash_combine(fingerprint, route_hash);
+  }
+  return fingerprint;
+}
+
 inline void check_precedence(const Input& input,
                              std::unordered_set<Index>& expected_delivery_ranks,
                              Index job_rank) {
@@ -8,6 +8,7 @@ All rights reserved (see LICENSE).
 */
 
 #include <algorithm>
+#include <thread>
 
 #include "../include/rapidjson/document.h"
 #include "../include/rapidjson/error/en.h"
@@ -471,7 +472,152 @@ inline Job get_job(const rapidjson::Value& json_job, unsigned amount_size) {
              get_string(json_job, "description"));
 }
 
-template <class T> inline Matrix<T> get_matrix(rapidjson::Value& m) {
+inline std::pair<Job, Job> get_shipment(const rapidjson::Value& json_shipment,
+                                       unsigned amount_size) {
+  check_shipment(json_shipment);
+
+  // Retrieve common stuff for both pickup and delivery.
+  auto amount = get_amount(json_shipment, "amount", amount_size);
+  auto skills = get_skills(json_shipment);
+  auto priority = get_priority(json_shipment);
+
+  // Defining pickup job.
+  auto& json_pickup = json_shipment["pickup"];
+  check_id(json_pickup, "pickup");
+
+  Job pickup(json_pickup["id"].GetUint64(),
+             JOB_TYPE::PICKUP,
+             get_task_location(json_pickup, "pickup"),
+             get_duration(json_pickup, "setup"),
+             get_duration(json_pickup, "service"),
+             amount,
+             skills,
+             priority,
+             get_time_windows(json_pickup),
+             get_string(json_pickup, "description"));
+
+  // Defining delivery job.
+  auto& json_delivery = json_shipment["delivery"];
+  check_id(json_delivery, "delivery");
+
+  Job delivery(json_delivery["id"].GetUint64(),
+               JOB_TYPE::DELIVERY,
+               get_task_location(json_delivery, "delivery"),
+               get_duration(json_delivery, "setup"),
+               get_duration(json_delivery, "service"),
+               amount,
+               skills,
+               priority,
+               get_time_windows(json_delivery),
+               get_string(json_delivery, "description"));
+
+  return std::make_pair(std::move(pickup), std::move(delivery));
+}
+
+// Split [0, size) into contiguous ranges, one per thread. Threads
+// are only used when each range holds at least min_range_size
+// elements so small inputs are still handled in a single pass.
+inline std::vector<std::pair<std::size_t, std::size_t>>
+get_thread_ranges(std::size_t size, unsigned nb_threads) {
+  constexpr std::size_t min_range_size = 256;
+
+  const std::size_t nb_ranges =
+    std::max(static_cast<std::size_t>(1),
+             std::min(static_cast<std::size_t>(nb_threads),
+                      size / min_range_size));
+
+  std::vector<std::pair<std::size_t, std::size_t>> ranges;
+  ranges.reserve(nb_ranges);
+  std::size_t begin = 0;
+  for (std::size_t r = 0; r < nb_ranges; ++r) {
+    const std::size_t end =
+      begin + size / nb_ranges + ((r < size % nb_ranges) ? 1 : 0);
+    ranges.emplace_back(begin, end);
+    begin = end;
+  }
+
+  return ranges;
+}
+
+// Run f(i) for all i in [0, size) across threads. Each thread stops
+// at its first exception, which is stored in failures along with
+// the matching rank.
+template <class F>
+inline std::vector<std::pair<std::size_t, std::exception_ptr>>
+run_on_ranges(std::size_t size, unsigned nb_threads, const F& f) {
+  const auto ranges = get_thread_ranges(size, nb_threads);
+  std::vector<std::pair<std::size_t, std::exception_ptr>>
+    failures(ranges.size(), std::make_pair(size, nullptr));
+
+  auto run_on_range = [&](std::size_t range_rank) {
+    const auto& range = ranges[range_rank];
+    for (std::size_t i = range.first; i < range.second; ++i) {
+      try {
+        f(i);
+      } catch (...) {
+        failures[range_rank] = std::make_pair(i, std::current_exception());
+        break;
+      }
+    }
+  };
+
+  if (ranges.size() == 1) {
+    run_on_range(0);
+  } else {
+    std::vector<std::thread> threads;
+    threads.reserve(ranges.size());
+    for (std::size_t r = 0; r < ranges.size(); ++r) {
+      threads.emplace_back(run_on_range, r);
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  return failures;
+}
+
+// Build objects from all elements in json array across threads,
+// then hand them over to add in array order. An exception raised
+// while building an element is only rethrown after all previous
+// elements have been added, so errors are reported just as with a
+// plain sequential loop.
+template <class T, class Build, class Add>
+inline void build_and_add(const rapidjson::Value& array,
+                          unsigned nb_threads,
+                          const Build& build,
+                          const Add& add) {
+  const std::size_t size = array.Size();
+  std::vector<std::optional<T>> objects(size);
+
+  const auto failures =
+    run_on_ranges(size, nb_threads, [&](std::size_t i) {
+      objects[i].emplace(build(array[static_cast<rapidjson::SizeType>(i)]));
+    });
+
+  std::size_t first_failure = size;
+  std::exception_ptr ep = nullptr;
+  for (const auto& failure : failures) {
+    if (failure.second != nullptr) {
+      // Ranges are sorted so the first failure is the lowest one.
+      first_failure = failure.first;
+      ep = failure.second;
+      break;
+    }
+  }
+
+  for (std::size_t i = 0; i < first_failure; ++i) {
+    add(std::move(objects[i].value()));
+  }
+
+  if (ep != nullptr) {
+    std::rethrow_exception(ep);
+  }
+}
+
+template <class T>
+inline Matrix<T> get_matrix(const rapidjson::Value& m, unsigned nb_threads) {
   if (!m.IsArray()) {
     throw InputException("Invalid matrix.");
   }
@@ -479,23 +625,36 @@ template <class T> inline Matrix<T> get_matrix(rapidjson::Value& m) {
   rapidjson::SizeType matrix_size = m.Size();
 
   Matrix<T> matrix(matrix_size);
-  for (rapidjson::SizeType i = 0; i < matrix_size; ++i) {
-    if (!m[i].IsArray() or m[i].Size() != matrix_size) {
-      throw InputException("Unexpected matrix line length.");
-    }
-    rapidjson::Document::Array mi = m[i].GetArray();
-    for (rapidjson::SizeType j = 0; j < matrix_size; ++j) {
-      if (!mi[j].IsUint()) {
-        throw InputException("Invalid matrix entry.");
+
+  // Rows are filled independently across threads.
+  const auto failures =
+    run_on_ranges(matrix_size, nb_threads, [&](std::size_t i) {
+      const auto& mi = m[static_cast<rapidjson::SizeType>(i)];
+      if (!mi.IsArray() or mi.Size() != matrix_size) {
+        throw InputException("Unexpected matrix line length.");
+      }
+      T* const row = matrix[i];
+      for (rapidjson::SizeType j = 0; j < matrix_size; ++j) {
+        if (!mi[j].IsUint()) {
+          throw InputException("Invalid matrix entry.");
+        }
+        row[j] = mi[j].GetUint();
       }
-      matrix[i][j] = mi[j].GetUint();
+    });
+
+  for (const auto& failure : failures) {
+    if (failure.second != nullptr) {
+      std::rethrow_exception(failure.second);
     }
   }
 
   return matrix;
 }
 
-void parse(Input& input, const std::string& input_str, bool geometry) {
+void parse(Input& input,
+           const std::string& input_str,
+           bool geometry,
+           unsigned nb_threads) {
   // Input json object.
   rapidjson::Document json_input;
 
@@ -533,63 +692,39 @@ void parse(Input& input, const std::string& input_str, bool geometry) {
   input.set_geometry(geometry);
 
   // Add all vehicles.
-  for (rapidjson::SizeType i = 0; i < json_input["vehicles"].Size(); ++i) {
-    auto& json_vehicle = json_input["vehicles"][i];
-
-    input.add_vehicle(get_vehicle(json_vehicle, amount_size));
-  }
+  build_and_add<Vehicle>(json_input["vehicles"],
+                         nb_threads,
+                         [&](const auto& json_vehicle) {
+                           return get_vehicle(json_vehicle, amount_size);
+                         },
+                         [&](Vehicle&& vehicle) {
+                           input.add_vehicle(std::move(vehicle));
+                         });
 
   // Add all tasks.
   if (has_jobs) {
     // Add the jobs.
-    for (rapidjson::SizeType i = 0; i < json_input["jobs"].Size(); ++i) {
-      input.add_job(get_job(json_input["jobs"][i], amount_size));
-    }
+    build_and_add<Job>(json_input["jobs"],
+                       nb_threads,
+                       [&](const auto& json_job) {
+                         return get_job(json_job, amount_size);
+                       },
+                       [&](Job&& job) { input.add_job(std::move(job)); });
   }
 
   if (has_shipments) {
     // Add the shipments.
-    for (rapidjson::SizeType i = 0; i < json_input["shipments"].Size(); ++i) {
-      auto& json_shipment = json_input["shipments"][i];
-      check_shipment(json_shipment);
-
-      // Retrieve common stuff for both pickup and delivery.
-      auto amount = get_amount(json_shipment, "amount", amount_size);
-      auto skills = get_skills(json_shipment);
-      auto priority = get_priority(json_shipment);
-
-      // Defining pickup job.
-      auto& json_pickup = json_shipment["pickup"];
-      check_id(json_pickup, "pickup");
-
-      Job pickup(json_pickup["id"].GetUint64(),
-                 JOB_TYPE::PICKUP,
-                 get_task_location(json_pickup, "pickup"),
-                 get_duration(json_pickup, "setup"),
-                 get_duration(json_pickup, "service"),
-                 amount,
-                 skills,
-                 priority,
-                 get_time_windows(json_pickup),
-                 get_string(json_pickup, "description"));
-
-      // Defining delivery job.
-      auto& json_delivery = json_shipment["delivery"];
-      check_id(json_delivery, "delivery");
-
-      Job delivery(json_delivery["id"].GetUint64(),
-                   JOB_TYPE::DELIVERY,
-                   get_task_location(json_delivery, "delivery"),
-                   get_duration(json_delivery, "setup"),
-                   get_duration(json_delivery, "service"),
-                   amount,
-                   skills,
-                   priority,
-                   get_time_windows(json_delivery),
-                   get_string(json_delivery, "description"));
-
-      input.add_shipment(pickup, delivery);
-    }
+    build_and_add<std::pair<Job, Job>>(json_input["shipments"],
+                                       nb_threads,
+                                       [&](const auto& json_shipment) {
+                                         return get_shipment(json_shipment,
+                                                             amount_size);
+                                       },
+                                       [&](std::pair<Job, Job>&& shipment) {
+                                         input.add_shipment(
+                                           std::move(shipment.first),
+                                           std::move(shipment.second));
+                                       });
   }
 
   if (json_input.HasMember("matrices")) {
@@ -601,12 +736,14 @@ void parse(Input& input, const std::string& input_str, bool geometry) {
         if (profile_entry.value.HasMember("durations")) {
           input.set_durations_matrix(profile_entry.name.GetString(),
                                      get_matrix<UserDuration>(
-                                       profile_entry.value["durations"]));
+                                       profile_entry.value["durations"],
+                                       nb_threads));
         }
         if (profile_entry.value.HasMember("costs")) {
           input.set_costs_matrix(profile_entry.name.GetString(),
                                  get_matrix<UserCost>(
-                                   profile_entry.value["costs"]));
+                                   profile_entry.value["costs"],
+                                   nb_threads));
         }
       }
     }
@@ -616,8 +753,59 @@ void parse(Input& input, const std::string& input_str, bool geometry) {
     if (json_input.HasMember("matrix")) {
       input.set_durations_matrix(DEFAULT_PROFILE,
                                  get_matrix<UserDuration>(
-                                   json_input["matrix"]));
+                                   json_input["matrix"],
+                                   nb_threads));
+    }
+  }
+}
+
+void parse_previous_solution(Input& input, const std::string& solution_str) {
+  rapidjson::Document json_solution;
+
+  if (json_solution.Parse(solution_str.c_str()).HasParseError()) {
+    std::string error_msg =
+      std::string(rapidjson::GetParseError_En(json_solution.GetParseError())) +
+      " (offset: " + std::to_string(json_solution.GetErrorOffset()) + ")";
+    throw InputException(error_msg);
+  }
+
+  if (!json_solution.HasMember("routes") or
+      !json_solution["routes"].IsArray()) {
+    throw InputException("Invalid routes in previous solution.");
+  }
+
+  for (const auto& json_route : json_solution["routes"].GetArray()) {
+    if (!json_route.HasMember("vehicle") or
+        !json_route["vehicle"].IsUint64() or !json_route.HasMember("steps") or
+        !json_route["steps"].IsArray()) {
+      throw InputException("Invalid route in previous solution.");
     }
+
+    std::vector<VehicleStep> steps;
+    for (const auto& json_step : json_route["steps"].GetArray()) {
+      const auto type_str = get_string(json_step, "type");
+      if (type_str != "job" and type_str != "pickup" and
+          type_str != "delivery") {
+        // Only tasks are relevant when repairing routes.
+        continue;
+      }
+
+      if (!json_step.HasMember("id") or !json_step["id"].IsUint64()) {
+        throw InputException(
+          "Invalid id in previous solution steps for vehicle " +
+          std::to_string(json_route["vehicle"].GetUint64()) + ".");
+      }
+
+      const auto job_type = (type_str == "job")      ? JOB_TYPE::SINGLE
+                            : (type_str == "pickup") ? JOB_TYPE::PICKUP
+                                                     : JOB_TYPE::DELIVERY;
+      steps.emplace_back(job_type,
+                         json_step["id"].GetUint64(),
+                         ForcedService());
+    }
+
+    input.add_previous_route(json_route["vehicle"].GetUint64(),
+                             std::move(steps));
   }
 }
 
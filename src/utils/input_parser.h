@@ -15,7 +15,16 @@ All rights reserved (see LICENSE).
 
 namespace vroom::io {
 
-void parse(Input& input, const std::string& input_str, bool geometry);
+// Objects described in json input are built using up to nb_threads
+// threads, then added to input in the same order as in the json
+// arrays.
+void parse(Input& input,
+           const std::string& input_str,
+           bool geometry,
+           unsigned nb_threads = 1);
+
+// Read routes from a json solution to warm start solving input.
+void parse_previous_solution(Input& input, const std::string& solution_str);
 
 } // namespace vroom::io
 
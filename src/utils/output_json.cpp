@@ -13,6 +13,7 @@ All rights reserved (see LICENSE).
 #include "../include/rapidjson/stringbuffer.h"
 #include "../include/rapidjson/writer.h"
 
+#include "utils/helpers.h"
 #include "utils/output_json.h"
 
 namespace vroom::io {
@@ -180,6 +181,12 @@ rapidjson::Value to_json(const Summary& summary,
                          to_json(summary.computing_times, geometry, allocator),
                          allocator);
 
+  if (summary.solving_stats.has_value()) {
+    json_summary.AddMember("solving_stats",
+                           to_json(summary.solving_stats.value(), allocator),
+                           allocator);
+  }
+
   return json_summary;
 }
 
@@ -257,6 +264,7 @@ rapidjson::Value to_json(const ComputingTimes& ct,
   rapidjson::Value json_ct(rapidjson::kObjectType);
 
   json_ct.AddMember("loading", ct.loading, allocator);
+  json_ct.AddMember("preprocessing", ct.preprocessing, allocator);
   json_ct.AddMember("solving", ct.solving, allocator);
 
   if (geometry) {
@@ -267,6 +275,50 @@ rapidjson::Value to_json(const ComputingTimes& ct,
   return json_ct;
 }
 
+inline UserDuration to_ms(std::chrono::nanoseconds d) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+rapidjson::Value to_json(const SolvingStats& stats,
+                         rapidjson::Document::AllocatorType& allocator) {
+  rapidjson::Value json_stats(rapidjson::kObjectType);
+
+  rapidjson::Value json_operators(rapidjson::kArrayType);
+  for (std::size_t op = 0; op < OperatorName::MAX; ++op) {
+    const auto& op_stats = stats.operators[op];
+
+    rapidjson::Value json_op(rapidjson::kObjectType);
+    json_op.AddMember("name", rapidjson::Value(), allocator);
+    json_op["name"].SetString(utils::operator_names[op].c_str(),
+                              utils::operator_names[op].size(),
+                              allocator);
+    json_op.AddMember("evaluated", op_stats.tried_moves, allocator);
+    json_op.AddMember("applied", op_stats.applied_moves, allocator);
+    json_op.AddMember("gain",
+                      utils::scale_to_user_cost(op_stats.gain),
+                      allocator);
+    json_op.AddMember("time", to_ms(op_stats.time), allocator);
+
+    json_operators.PushBack(json_op, allocator);
+  }
+  json_stats.AddMember("operators", json_operators, allocator);
+
+  rapidjson::Value json_phases(rapidjson::kObjectType);
+  json_phases.AddMember("heuristics", to_ms(stats.heuristics), allocator);
+  json_phases.AddMember("local_search", to_ms(stats.local_search), allocator);
+  json_phases.AddMember("state_updates", to_ms(stats.state_updates), allocator);
+  json_phases.AddMember("job_additions", to_ms(stats.job_additions), allocator);
+  json_stats.AddMember("phases", json_phases, allocator);
+
+  rapidjson::Value json_threads(rapidjson::kArrayType);
+  for (const auto usage : stats.thread_usage) {
+    json_threads.PushBack(usage, allocator);
+  }
+  json_stats.AddMember("threads", json_threads, allocator);
+
+  return json_stats;
+}
+
 rapidjson::Value to_json(const Step& s,
                          bool geometry,
                          rapidjson::Document::AllocatorType& allocator) {
@@ -360,6 +412,31 @@ rapidjson::Value to_json(const Location& loc,
   return json_coords;
 }
 
+rapidjson::Document to_json(const Progress& progress) {
+  rapidjson::Document json_output;
+  json_output.SetObject();
+  rapidjson::Document::AllocatorType& allocator = json_output.GetAllocator();
+
+  json_output.AddMember("solving", progress.solving, allocator);
+  json_output.AddMember("priority", progress.priority, allocator);
+  json_output.AddMember("assigned", progress.assigned, allocator);
+  json_output.AddMember("unassigned", progress.unassigned, allocator);
+  json_output.AddMember("cost", progress.cost, allocator);
+  json_output.AddMember("duration", progress.duration, allocator);
+  json_output.AddMember("routes", progress.routes, allocator);
+
+  if (progress.solution.has_value()) {
+    // Geometry is only computed once solving is over.
+    auto json_solution = to_json(progress.solution.value(), false);
+
+    rapidjson::Value json_copy;
+    json_copy.CopyFrom(json_solution, allocator);
+    json_output.AddMember("solution", json_copy, allocator);
+  }
+
+  return json_output;
+}
+
 void write_to_json(const Solution& sol,
                    bool geometry,
                    const std::string& output_file) {
@@ -382,4 +459,14 @@ void write_to_json(const Solution& sol,
   }
 }
 
+void write_to_json(const Progress& progress, std::ostream& out_stream) {
+  auto json_output = to_json(progress);
+
+  rapidjson::StringBuffer s;
+  rapidjson::Writer<rapidjson::StringBuffer> r_writer(s);
+  json_output.Accept(r_writer);
+
+  out_stream << s.GetString() << std::endl;
+}
+
 } // namespace vroom::io
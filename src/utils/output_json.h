@@ -10,7 +10,10 @@ All rights reserved (see LICENSE).
 
 */
 
+#include <ostream>
+
 #include "../include/rapidjson/document.h"
+#include "structures/vroom/solution/progress.h"
 #include "structures/vroom/solution/solution.h"
 
 namespace vroom::io {
@@ -25,6 +28,9 @@ rapidjson::Value to_json(const ComputingTimes& ct,
                          bool geometry,
                          rapidjson::Document::AllocatorType& allocator);
 
+rapidjson::Value to_json(const SolvingStats& stats,
+                         rapidjson::Document::AllocatorType& allocator);
+
 rapidjson::Value to_json(const Route& route,
                          bool geometry,
                          rapidjson::Document::AllocatorType& allocator);
@@ -36,10 +42,15 @@ rapidjson::Value to_json(const Step& s,
 rapidjson::Value to_json(const Location& loc,
                          rapidjson::Document::AllocatorType& allocator);
 
+rapidjson::Document to_json(const Progress& progress);
+
 void write_to_json(const Solution& sol,
                    bool geometry,
                    const std::string& output_file);
 
+// Write progress as a single json line.
+void write_to_json(const Progress& progress, std::ostream& out_stream);
+
 } // namespace vroom::io
 
 #endif